@@ -1,6 +1,8 @@
 #include "Actor.h"
 #include "StudentWorld.h"
+#include "DistanceKernel.h"
 #include <algorithm>
+#include <cstdlib>
 #include <string>
 using namespace std;
 
@@ -25,7 +27,7 @@ int Point::getY() const
     return m_y;
 }
 
-Point& Point::operator=(Point& p)
+Point& Point::operator=(const Point& p)
 {
     this->m_x = p.m_x;
     this->m_y = p.m_y;
@@ -158,11 +160,15 @@ Actor::Actor(int imageID, int startX, int startY, Direction dir, double size, un
     bool isPassable)
     :GraphObject(imageID, startX, startY, dir, size, depth),
     m_BB(BoundingBox(startX, startY)),
-    m_isPassable(isPassable),
-    m_isDamageable(isDamageable),
+    m_ticksAlive(0),
+    m_slot(-1),
+    m_snapshotSlot(-1),
+    m_occupant(OCC_NONE),
     m_health(health),
+    m_iFrames(0),
     m_isAlive(true),
-    m_ticksAlive(0)
+    m_isDamageable(isDamageable),
+    m_isPassable(isPassable)
 {
 
 }
@@ -305,6 +311,34 @@ void Actor::setDead()
 {
     m_isAlive = false;
     setVisible(false);
+    setOccupant(OCC_NONE);
+}
+
+void Actor::moveTo(int x, int y)
+{
+    if (m_occupant != OCC_NONE && (x != getX() || y != getY()))
+    {
+        OccupancyGrid* grid = getWorld()->getOccupancy();
+        grid->remove(m_occupant, getX(), getY());
+        grid->add(m_occupant, x, y);
+    }
+
+    GraphObject::moveTo(x, y);
+}
+
+void Actor::setOccupant(Occupant type)
+{
+    if (type == m_occupant)
+        return;
+
+    OccupancyGrid* grid = getWorld()->getOccupancy();
+
+    if (m_occupant != OCC_NONE)
+        grid->remove(m_occupant, getX(), getY());
+    if (type != OCC_NONE)
+        grid->add(type, getX(), getY());
+
+    m_occupant = type;
 }
 
 int Actor::getTicksAlive() const
@@ -312,9 +346,54 @@ int Actor::getTicksAlive() const
     return m_ticksAlive;
 }
 
-Actor::~Actor()
+void Actor::setSlot(int slot)
+{
+    m_slot = slot;
+}
+
+int Actor::getSlot() const
+{
+    return m_slot;
+}
+
+void Actor::setSnapshotSlot(int slot)
 {
+    m_snapshotSlot = slot;
+}
+
+int Actor::getSnapshotSlot() const
+{
+    return m_snapshotSlot;
+}
 
+void Actor::saveState(ActorRecord& r)
+{
+    r.direction = getDirection();
+    r.visible = isVisible();
+    r.occupant = m_occupant;
+    r.x = getX();
+    r.y = getY();
+    r.health = m_health;
+    r.ticksAlive = m_ticksAlive;
+    r.iFrames = m_iFrames;
+}
+
+void Actor::restoreState(const ActorRecord& r)
+{
+    setDirection((Direction)r.direction);
+    setVisible(r.visible != 0);
+    moveTo(r.x, r.y);
+    setOccupant((Occupant)r.occupant);
+    m_BB.updateBB(r.x, r.y);
+    m_health = r.health;
+    m_ticksAlive = r.ticksAlive;
+    m_iFrames = r.iFrames;
+    m_isAlive = true;
+}
+
+Actor::~Actor()
+{
+    setOccupant(OCC_NONE);
 }
 
 
@@ -381,7 +460,7 @@ void Iceman::doSomething()
                 {
                     if (world->getIceManager()->clearIce(getX() - 1, getY()))
                     {
-                        world->getPathFinder()->updateGrid();
+                        world->getPathFinder()->updateGrid(getX() - 1, getY());
                         world->playSound(SOUND_DIG);
                     }
 
@@ -415,7 +494,7 @@ void Iceman::doSomething()
                 {
                     if (world->getIceManager()->clearIce(getX(), getY() + 1))
                     {
-                        world->getPathFinder()->updateGrid();
+                        world->getPathFinder()->updateGrid(getX(), getY() + 1);
                         world->playSound(SOUND_DIG);
                     }
 
@@ -450,7 +529,7 @@ void Iceman::doSomething()
                 {
                     if (world->getIceManager()->clearIce(getX() + 1, getY()))
                     {
-                        world->getPathFinder()->updateGrid();
+                        world->getPathFinder()->updateGrid(getX() + 1, getY());
                         world->playSound(SOUND_DIG);
                     }
 
@@ -484,7 +563,7 @@ void Iceman::doSomething()
                 {
                     if (world->getIceManager()->clearIce(getX(), getY() - 1))
                     {
-                        world->getPathFinder()->updateGrid();
+                        world->getPathFinder()->updateGrid(getX(), getY() - 1);
                         world->playSound(SOUND_DIG);
                     }
 
@@ -507,7 +586,7 @@ void Iceman::doSomething()
                     int squirtX = getX() + (dir == left || dir == right ? (dir == left ? -4 : 4) : 0);
                     int squirtY = getY() + (dir == down || dir == up ? (dir == down ? -4 : 4) : 0);
 
-                    if (squirtX < 0 || squirtX > 63 || squirtY < 0 || squirtY > 63)
+                    if (squirtX < 0 || squirtX > 60 || squirtY < 0 || squirtY > 60)
                     {
                         break;
                     }
@@ -547,17 +626,17 @@ void Iceman::doSomething()
                 if (m_numSonarKits > 0)
                 {
                     world->playSound(SOUND_SONAR);
-                    world->scan(getX() + 1.5, getY() + 1.5);
+                    world->scan(getX(), getY());
                     m_numSonarKits--;
                 }
                 break;
-                // For testing purposes
-            case 'R':
-            case 'r':
-
-                //world->getPathFinder()->buildPaths();
-                world->placePathTester(getX(), getY());
-
+            case 'K':
+            case 'k':
+                world->requestCheckpoint();
+                break;
+            case 'B':
+            case 'b':
+                world->requestRewind();
                 break;
             }
         }
@@ -611,6 +690,31 @@ int Iceman::getNumGoldNuggets()
     return m_numGoldNuggets;
 }
 
+// Every player move goes through here so that hidden items near the new
+// cell are revealed or collected without them polling each tick.
+void Iceman::moveTo(int x, int y)
+{
+    Actor::moveTo(x, y);
+    getWorld()->getTriggers()->playerMovedTo(x, y);
+}
+
+void Iceman::saveState(ActorRecord& r)
+{
+    Actor::saveState(r);
+    r.kind = SNAP_ICEMAN;
+    r.fields[0] = m_numSonarKits;
+    r.fields[1] = m_numGoldNuggets;
+    r.fields[2] = m_numSquirts;
+}
+
+void Iceman::restoreState(const ActorRecord& r)
+{
+    Actor::restoreState(r);
+    m_numSonarKits = r.fields[0];
+    m_numGoldNuggets = r.fields[1];
+    m_numSquirts = r.fields[2];
+}
+
 Iceman::~Iceman()
 {
 
@@ -631,15 +735,19 @@ Protester::Protester(int imageID,
         health,
         true,
         true),
-    m_state(InOilField),
+    m_ticksSinceAxisSwap(0),
     m_nonShoutingActions(0),
     m_stunTicksLeft(0),
-    m_ticksSinceAxisSwap(0),
-    m_pathOut("")
+    m_pathVersion(0),
+    m_awaitingPath(false),
+    m_state(InOilField),
+    m_isBribed(false)
 {
     setVisible(true);
-    m_restingTickCount = max(0, 3 - (int)getWorld()->getLevel() / 4);
-    m_stepsInCurrDir = rand() % 53 + 8;
+    setOccupant(OCC_PROTESTER);
+    // from level 12 on a protester moves every tick
+    m_restingTickCount = max(1, 3 - (int)getWorld()->getLevel() / 4);
+    m_stepsInCurrDir = getWorld()->getRandom().nextInt(53) + 8;
 }
 
 void Protester::doSomething()
@@ -658,21 +766,30 @@ void Protester::doSomething()
             }
             else
             {
-                if (m_pathOut.empty())
+                PathFinder* pathFinder = world->getPathFinder();
+
+                // ask again once the map has opened up a shorter way out; the
+                // answer comes on a later tick, so keep going the way we were
+                // until then
+                if (!m_awaitingPath && (m_pathOut.empty() || (m_pathVersion != pathFinder->getGridVersion()
+                    && pathFinder->getExitDistance(getX(), getY()) < m_pathOut.size())))
                 {
-                    m_pathOut = world->getPathFinder()->getPathToExitFrom(getX(), getY());
+                    world->getPathRequests()->submit(this);
+                    m_awaitingPath = true;
                 }
 
-                string temp_path = world->getPathFinder()->getPathToExitFrom(getX(), getY());
+                Direction dir = m_pathOut.empty() ? getDirection() : m_pathOut.front();
 
-                if (temp_path.length() < m_pathOut.length())
+                if (!pathFinder->canMove(getX(), getY(), dir))
                 {
-                    m_pathOut = temp_path;
+                    // a boulder has settled across the route
+                    m_pathOut.clear();
+                    return;
                 }
 
-                switch (m_pathOut[0])
+                switch (dir)
                 {
-                case 'L':
+                case left:
 
                     if (getDirection() != left)
                     {
@@ -681,7 +798,7 @@ void Protester::doSomething()
 
                     moveTo(getX() - 1, getY());
                     break;
-                case 'U':
+                case up:
 
                     if (getDirection() != up)
                     {
@@ -690,7 +807,7 @@ void Protester::doSomething()
 
                     moveTo(getX(), getY() + 1);
                     break;
-                case 'R':
+                case right:
 
                     if (getDirection() != right)
                     {
@@ -699,7 +816,7 @@ void Protester::doSomething()
 
                     moveTo(getX() + 1, getY());
                     break;
-                case 'D':
+                case down:
 
                     if (getDirection() != down)
                     {
@@ -708,12 +825,12 @@ void Protester::doSomething()
 
                     moveTo(getX(), getY() - 1);
                     break;
-                case 'E':
-                    setDead();
+                default:
                     break;
                 }
 
-                m_pathOut = m_pathOut.substr(1);
+                if (!m_pathOut.empty())
+                    m_pathOut.advance();
                 return;
             }
         }
@@ -723,9 +840,9 @@ void Protester::doSomething()
             {
                 Iceman* player = world->getPlayer();
 
-                int distToPlayer = world->getDistSquared(getBB().getXY(), player->getBB().getXY());
+                int distToPlayer = world->getDistSquaredToPlayer(this);
 
-                if (m_nonShoutingActions >= 15 && distToPlayer <= 25)
+                if (m_nonShoutingActions >= 15 && distToPlayer <= toDoubledRadiusSquared(5))
                 {
                     if (isFacing(player) && world->getPathFinder()->hasUnobstructedPathToPlayer(this))
                     {
@@ -790,9 +907,62 @@ void Protester::takeDamage(DamageSource src)
     }
 }
 
-Protester::~Protester()
+void Protester::receivePath(PackedPath& path, unsigned int gridVersion)
+{
+    m_pathOut.swap(path);
+    m_pathVersion = gridVersion;
+    m_awaitingPath = false;
+}
+
+void Protester::saveState(ActorRecord& r)
+{
+    Actor::saveState(r);
+    r.fields[0] = m_stepsInCurrDir;
+    r.fields[1] = m_ticksSinceAxisSwap;
+    r.fields[2] = m_nonShoutingActions;
+    r.fields[3] = m_restingTickCount;
+    r.fields[4] = m_stunTicksLeft;
+    r.fields[5] = m_state;
+    r.fields[6] = m_isBribed;
+    r.pathLength = getPathLength();
+    r.pathVersion = m_pathVersion;
+}
+
+void Protester::restoreState(const ActorRecord& r)
 {
+    Actor::restoreState(r);
+    m_stepsInCurrDir = r.fields[0];
+    m_ticksSinceAxisSwap = r.fields[1];
+    m_nonShoutingActions = r.fields[2];
+    m_restingTickCount = r.fields[3];
+    m_stunTicksLeft = r.fields[4];
+    m_state = (States)r.fields[5];
+    m_isBribed = r.fields[6] != 0;
 
+    // the world puts the request back in the queue and the route back in
+    // place (see loadPath())
+    m_pathVersion = r.pathVersion;
+    m_awaitingPath = r.requestOrder >= 0;
+}
+
+int Protester::getPathLength() const
+{
+    return m_pathOut.size();
+}
+
+void Protester::savePath(unsigned long long* out) const
+{
+    m_pathOut.save(out, m_pathOut.size());
+}
+
+void Protester::loadPath(const unsigned long long* steps, int n)
+{
+    m_pathOut.load(steps, n);
+}
+
+Protester::~Protester()
+{
+    getWorld()->getPathRequests()->cancel(this);
 }
 
 
@@ -803,16 +973,22 @@ RegularProtester::RegularProtester(int x, int y) : Protester(IID_PROTESTER, 5, x
 
 }
 
-void RegularProtester::pathTowardsPlayer()
+// Shared by both kinds of protester: head straight for the player when in
+// sight, otherwise wander and occasionally turn at intersections.
+void Protester::roam()
 {
-    if (getWorld()->getPathFinder()->hasUnobstructedPathToPlayer(this))
+    PathFinder* pathFinder = getWorld()->getPathFinder();
+
+    if (pathFinder->hasUnobstructedPathToPlayer(this))
     {
         faceTowards(getWorld()->getPlayer());
 
         Direction dir = getDirection();
 
-        moveTo(getX() + (dir == left || dir == right ? (dir == left ? -1 : 1) : 0),
-            getY() + (dir == down || dir == up ? (dir == down ? -1 : 1) : 0));
+        // already on the player's cell, faceTowards() leaves dir as it was
+        if (pathFinder->canMove(getX(), getY(), dir))
+            moveTo(getX() + (dir == left || dir == right ? (dir == left ? -1 : 1) : 0),
+                getY() + (dir == down || dir == up ? (dir == down ? -1 : 1) : 0));
 
         m_stepsInCurrDir = 0;
 
@@ -825,55 +1001,32 @@ void RegularProtester::pathTowardsPlayer()
         Point newXY = Point(getX() + (dir == left || dir == right ? (dir == left ? -1 : 1) : 0),
             getY() + (dir == down || dir == up ? (dir == down ? -1 : 1) : 0));
 
-        string validDirs = getWorld()->getPathFinder()->getValidDirections(getBB().getXY());
+        unsigned char validDirs = pathFinder->getValidDirections(getX(), getY());
 
-        bool isXRoad = getWorld()->getPathFinder()->isIntersection(validDirs);
+        bool isXRoad = pathFinder->isIntersection(getX(), getY());
 
         if (m_stepsInCurrDir == 0 || !(newXY.isInBounds()))
         {
-            char ch = validDirs[rand() % validDirs.length()];
+            Direction newDir = PathFinder::chooseRandomDirection(validDirs, getWorld()->getRandom());
 
-            switch (ch)
+            if (newDir != none)
             {
-            case 'U':
-                setDirection(up);
-                break;
-            case 'D':
-                setDirection(down);
-                break;
-            case 'L':
-                setDirection(left);
-                break;
-            case 'R':
-                setDirection(right);
-                break;
+                setDirection(newDir);
             }
 
-            m_stepsInCurrDir = rand() % 52 + 8;
+            m_stepsInCurrDir = getWorld()->getRandom().nextInt(52) + 8;
         }
         else if (isXRoad && m_ticksSinceAxisSwap >= 50)
         {
-            validDirs = getWorld()->getPathFinder()->getValidPerpDirs(getBB().getXY(), dir);
-
-            char ch = validDirs[rand() % validDirs.length()];
+            Direction newDir = PathFinder::chooseRandomDirection(pathFinder->getValidPerpDirs(getX(), getY(), dir),
+                getWorld()->getRandom());
 
-            switch (ch)
+            if (newDir != none)
             {
-            case 'U':
-                setDirection(up);
-                break;
-            case 'D':
-                setDirection(down);
-                break;
-            case 'L':
-                setDirection(left);
-                break;
-            case 'R':
-                setDirection(right);
-                break;
+                setDirection(newDir);
             }
 
-            m_stepsInCurrDir = rand() % 52 + 8;
+            m_stepsInCurrDir = getWorld()->getRandom().nextInt(52) + 8;
 
             m_ticksSinceAxisSwap = 0;
         }
@@ -883,7 +1036,7 @@ void RegularProtester::pathTowardsPlayer()
         newXY = Point(getX() + (dir == left || dir == right ? (dir == left ? -1 : 1) : 0),
             getY() + (dir == down || dir == up ? (dir == down ? -1 : 1) : 0));
 
-        if (validDirs.length() >= 1 && getWorld()->getIceManager()->checkIce(newXY.m_x, newXY.m_y))
+        if (pathFinder->canMove(getX(), getY(), dir))
         {
             moveTo(newXY.m_x, newXY.m_y);
 
@@ -898,6 +1051,11 @@ void RegularProtester::pathTowardsPlayer()
     }
 }
 
+void RegularProtester::pathTowardsPlayer()
+{
+    roam();
+}
+
 void RegularProtester::foundGold()
 {
     StudentWorld* world = getWorld();
@@ -914,6 +1072,12 @@ int RegularProtester::getGiveUpPoints()
     return 100;
 }
 
+void RegularProtester::saveState(ActorRecord& r)
+{
+    Protester::saveState(r);
+    r.kind = SNAP_REGULAR_PROTESTER;
+}
+
 RegularProtester::~RegularProtester()
 {
 
@@ -922,136 +1086,51 @@ RegularProtester::~RegularProtester()
 HardcoreProtester::HardcoreProtester(int x, int y) : Protester(IID_HARD_CORE_PROTESTER, 20, x, y)
 {
     m_maxPathSize = 16 + getWorld()->getLevel() * 2;
+    getWorld()->getPathFinder()->requirePlayerFieldDepth(m_maxPathSize);
+}
+
+void HardcoreProtester::pathTowardsPlayer()
+{
+    StudentWorld* world = getWorld();
+    PathFinder* pathFinder = world->getPathFinder();
+
+    if (world->getDistSquaredToPlayer(this) > toDoubledRadiusSquared(4) &&
+        pathFinder->getPlayerDistance(getX(), getY()) <= (int)m_maxPathSize)
+    {
+        Direction dir = pathFinder->getDirTowardsPlayer(getX(), getY());
+
+        if (dir != none)
+        {
+            setDirection(dir);
+
+            moveTo(getX() + (dir == left || dir == right ? (dir == left ? -1 : 1) : 0),
+                getY() + (dir == down || dir == up ? (dir == down ? -1 : 1) : 0));
+
+            return;
+        }
+    }
+
+    roam();
 }
 
-//void HardcoreProtester::pathTowardsPlayer()
-//{
-//    StudentWorld* world = getWorld();
-//
-//    Iceman* player = world->getPlayer();
-//
-//    int distance = world->getDistSquared(getX(), getY(), player->getX(), player->getY());
-//
-//    if (distance <= 144 && m_nonShoutingActions > 15)
-//    {
-//        Point p = getBB().getXY();
-//
-//        Direction dir = world->getPathFinder()->getAdjPointClosestToPlayer(p, getDirection());
-//
-//        if (dir != GraphObject::Direction::none)
-//        {
-//            setDirection(dir);
-//            moveTo(p.m_x, p.m_y);
-//            return;
-//        }
-//    }
-//
-//    if (world->getPathFinder()->hasUnobstructedPathToPlayer(this))
-//    {
-//        faceTowards(getWorld()->getPlayer());
-//
-//        Direction dir = getDirection();
-//
-//        moveTo(	getX() + (dir == left || dir == right	?	(dir == left ? -1 : 1) : 0),
-//                   getY() + (dir == down || dir == up		?	(dir == down ? -1 : 1) : 0));
-//
-//        m_stepsInCurrDir = 0;
-//
-//        return;
-//    }
-//    else
-//    {
-//        Direction dir = getDirection();
-//
-//        Point newXY = Point(getX() + (dir == left || dir == right	?	(dir == left ? -1 : 1) : 0),
-//                            getY() + (dir == down || dir == up		?	(dir == down ? -1 : 1) : 0));
-//
-//        string validDirs = getWorld()->getPathFinder()->getValidDirections(getBB().getXY());
-//
-//        bool isXRoad = getWorld()->getPathFinder()->isIntersection(validDirs);
-//
-//        if (m_stepsInCurrDir == 0 || !(newXY.isInBounds()))
-//        {
-//            char ch = validDirs[rand() % validDirs.length()];
-//
-//            switch (ch)
-//            {
-//                case 'U':
-//                    setDirection(up);
-//                    break;
-//                case 'D':
-//                    setDirection(down);
-//                    break;
-//                case 'L':
-//                    setDirection(left);
-//                    break;
-//                case 'R':
-//                    setDirection(right);
-//                    break;
-//            }
-//
-//            m_stepsInCurrDir = rand() % 52 + 8;
-//        }
-//        else if (isXRoad && m_ticksSinceAxisSwap >= 50)
-//        {
-//            validDirs = getWorld()->getPathFinder()->getValidPerpDirs(getBB().getXY(), dir);
-//
-//            char ch = validDirs[rand() % validDirs.length()];
-//
-//            switch (ch)
-//            {
-//                case 'U':
-//                    setDirection(up);
-//                    break;
-//                case 'D':
-//                    setDirection(down);
-//                    break;
-//                case 'L':
-//                    setDirection(left);
-//                    break;
-//                case 'R':
-//                    setDirection(right);
-//                    break;
-//            }
-//
-//            m_stepsInCurrDir = rand() % 52 + 8;
-//
-//            m_ticksSinceAxisSwap = 0;
-//        }
-//
-//        dir = getDirection();
-//
-//        newXY = Point(	getX() + (dir == left || dir == right	?	(dir == left ? -1 : 1) : 0),
-//                          getY() + (dir == down || dir == up		?	(dir == down ? -1 : 1) : 0));
-//
-//        if (validDirs.length() >= 1 && getWorld()->getIceManager()->checkIce(newXY.m_x, newXY.m_y))
-//        {
-//            moveTo(newXY.m_x, newXY.m_y);
-//
-//            m_stepsInCurrDir--;
-//
-//            m_ticksSinceAxisSwap++;
-//        }
-//        else
-//        {
-//            m_stepsInCurrDir = 0;
-//        }
-//    }
-//}
-
-
-//void HardcoreProtester::foundGold()
-//{
-//    StudentWorld* world = getWorld();
-//
-//    world->playSound(SOUND_PROTESTER_FOUND_GOLD);
-//
-//}
-//
-//int HardcoreProtester::getGiveUpPoints()
-//{
-//    return 250;
-//}
+void HardcoreProtester::foundGold()
+{
+    StudentWorld* world = getWorld();
+
+    world->playSound(SOUND_PROTESTER_FOUND_GOLD);
+
+}
+
+int HardcoreProtester::getGiveUpPoints()
+{
+    return 250;
+}
+
+void HardcoreProtester::saveState(ActorRecord& r)
+{
+    Protester::saveState(r);
+    r.kind = SNAP_HARDCORE_PROTESTER;
+}
 
 HardcoreProtester::~HardcoreProtester()
 {
@@ -1077,71 +1156,130 @@ Ice::~Ice()
 }
 
 Boulder::Boulder(int startX, int startY)
-    : Actor(IID_BOULDER, startX, startY, down, SIZE_NORMAL, 1, 1, false, false), m_isStable(true), m_isFalling(false)
+    : Actor(IID_BOULDER, startX, startY, down, SIZE_NORMAL, 1, 1, false, false),
+    m_ticksUnstable(0), m_isStable(true), m_isFalling(false), m_startY(startY), m_landingY(startY)
 {
     setVisible(true);
+    setOccupant(OCC_BOULDER);
+
+    IceManager* ice = getWorld()->getIceManager();
+
+    if (ice->isRowClear(startX, startY - 1))
+        m_isStable = false;
+    else
+        ice->watchRow(startY - 1, this);
+}
+
+void Boulder::iceCleared(int y)
+{
+    if (!m_isStable || !getWorld()->getIceManager()->isRowClear(getX(), y))
+        return;
+
+    getWorld()->getIceManager()->unwatchRow(y, this);
+    m_isStable = false;
+    m_ticksUnstable = 0;
+}
+
+// The lowest row the boulder can reach, found once when it starts to fall
+// from the ice rows in bulk, then cut short by any boulder in the way. Only
+// the row each step would newly cover is checked, so the boulder's own cells
+// above it don't count.
+int Boulder::findLandingRow()
+{
+    StudentWorld* world = getWorld();
+    int landingY = getY() - world->getIceManager()->getDropDistance(getX(), getY());
+
+    for (int y = getY() - 1; y >= landingY; y--)
+        if (world->getOccupancy()->anyInBox(OCC_BOULDER, getX(), y, 4, 1))
+            return y + 1;
+
+    return landingY;
+}
+
+void Boulder::settle()
+{
+    setDead();
+    getWorld()->getPathFinder()->updateGrid(getX(), getY());
 }
 
-//void Boulder::doSomething()
-//{
-//    StudentWorld* world = getWorld();
-//
-//    if (world->getIceManager()->checkIce(getX(), getY() - 4) && m_isStable)
-//    {
-//        world->getIceManager()->clearIce(getX(), getY());
-//
-//        m_isStable = false;
-//        m_ticksUnstable = 0;
-//    }
-//
-//    if (!m_isStable && !m_isFalling)
-//    {
-//        if (m_ticksUnstable > 30)
-//        {
-//            world->playSound(SOUND_FALLING_ROCK);
-//            m_isFalling = true;
-//
-//            world->getPathFinder()->updateGrid();
-//        }
-//        else
-//        {
-//            m_ticksUnstable++;
-//        }
-//    }
-//
-//    if (m_isFalling)
-//    {
-//        BoundingBox BB = BoundingBox(getX(), getY() - 1);
-//
-//        Actor* collidedWith = world->collisionWith(this, BB);
-//
-//        if (world->getIceManager()->checkIce(getX(), getY() - 1))
-//        {
-//            if (collidedWith != nullptr && &*collidedWith != &*this)
-//            {
-//                if (collidedWith->isDamageable())
-//                {
-//                    collidedWith->takeDamage(rockFall);
-//                    setDead();
-//                }
-//            }
-//            moveTo(getX(), getY() - 1);
-//        }
-//        else
-//        {
-//            setDead();
-//        }
-//    }
-//}
+void Boulder::doSomething()
+{
+    if (m_isStable || !isAlive())
+        return;
+
+    StudentWorld* world = getWorld();
+
+    if (!m_isFalling)
+    {
+        if (m_ticksUnstable < 30)
+        {
+            m_ticksUnstable++;
+            return;
+        }
+
+        world->playSound(SOUND_FALLING_ROCK);
+        m_isFalling = true;
+        m_landingY = findLandingRow();
+    }
+
+    if (getY() == m_landingY)
+    {
+        // something below may have been dug out since the fall began
+        m_landingY = findLandingRow();
+
+        if (getY() == m_landingY)
+        {
+            settle();
+            return;
+        }
+    }
+
+    // still a boulder on the way down, so the rows it leaves and enters
+    // change the navigation table
+    moveTo(getX(), getY() - 1);
+    world->getPathFinder()->updateGrid(getX(), getY(), 5);
+    world->boulderAnnoyActors(getX(), getY());
+}
 
 void Boulder::takeDamage(DamageSource src)
 {
     return;
 }
 
-Boulder::~Boulder()
+void Boulder::saveState(ActorRecord& r)
 {
+    Actor::saveState(r);
+    r.kind = SNAP_BOULDER;
+    r.fields[0] = m_ticksUnstable;
+    r.fields[1] = m_isStable;
+    r.fields[2] = m_isFalling;
+    r.fields[3] = m_startY;
+    r.fields[4] = m_landingY;
+}
+
+void Boulder::restoreState(const ActorRecord& r)
+{
+    IceManager* ice = getWorld()->getIceManager();
+
+    // swap the watch the constructor set up for the saved one
+    if (m_isStable)
+        ice->unwatchRow(m_startY - 1, this);
 
+    Actor::restoreState(r);
+    m_ticksUnstable = r.fields[0];
+    m_isStable = r.fields[1] != 0;
+    m_isFalling = r.fields[2] != 0;
+    m_startY = r.fields[3];
+    m_landingY = r.fields[4];
+
+    if (m_isStable)
+        ice->watchRow(m_startY - 1, this);
+}
+
+Boulder::~Boulder()
+{
+    if (m_isStable)
+        getWorld()->getIceManager()->unwatchRow(m_startY - 1, this);
 }
 
 
@@ -1149,7 +1287,48 @@ Squirt::Squirt(int startX, int startY, Direction dir)
     : Actor(IID_WATER_SPURT, startX, startY, dir, SIZE_NORMAL, 1, 1, false, true), m_movesLeft(4)
 {
     setVisible(true);
+    setOccupant(OCC_OTHER);
     firstRun = true;
+
+    resolveTrajectory();
+}
+
+void Squirt::resolveTrajectory()
+{
+    StudentWorld* world = getWorld();
+    PathFinder* pathFinder = world->getPathFinder();
+    Direction dir = getDirection();
+
+    m_clearSteps = pathFinder->getClearRun(getX(), getY(), dir, m_movesLeft);
+    m_gridVersion = pathFinder->getGridVersion();
+
+    // protesters move at most a cell a tick, so widen the swept cells by
+    // the squirt's remaining lifetime as well as its reach
+    int endX = getX() + (dir == left || dir == right ? (dir == left ? -m_clearSteps : m_clearSteps) : 0);
+    int endY = getY() + (dir == down || dir == up ? (dir == down ? -m_clearSteps : m_clearSteps) : 0);
+    int reach = 3 + m_movesLeft;
+
+    m_targets.clear();
+    world->findProtesters(min(getX(), endX) - reach, min(getY(), endY) - reach,
+        max(getX(), endX) + reach, max(getY(), endY) + reach, m_targets);
+    m_protesterGeneration = world->getProtesterGeneration();
+}
+
+// Most digs and boulders are nowhere near the squirt and leave its run as it
+// was, and the protesters found for a run still cover any shorter one.
+void Squirt::recheckRun()
+{
+    PathFinder* pathFinder = getWorld()->getPathFinder();
+    int run = pathFinder->getClearRun(getX(), getY(), getDirection(), m_movesLeft);
+
+    if (run > m_clearSteps)
+    {
+        resolveTrajectory();
+        return;
+    }
+
+    m_clearSteps = run;
+    m_gridVersion = pathFinder->getGridVersion();
 }
 
 void Squirt::doSomething()
@@ -1164,14 +1343,37 @@ void Squirt::doSomething()
 
     if (m_movesLeft > 0)
     {
+        if (world->getProtesterGeneration() != m_protesterGeneration)
+            resolveTrajectory();
+        else if (world->getPathFinder()->getGridVersion() != m_gridVersion)
+            recheckRun();
+
+        if (m_clearSteps == 0)
+        {
+            setDead();
+            return;
+        }
+
         Direction dir = getDirection();
 
         int squirtX = getX() + (dir == left || dir == right ? (dir == left ? -1 : 1) : 0);
         int squirtY = getY() + (dir == down || dir == up ? (dir == down ? -1 : 1) : 0);
 
-        BoundingBox BB = BoundingBox(squirtX, squirtY);
+        bool hit = false;
+
+        for (size_t i = 0; i != m_targets.size(); i++)
+        {
+            Protester* p = m_targets[i];
+
+            if (p->isAlive() && p->getState() == Protester::InOilField &&
+                abs(p->getX() - squirtX) <= 3 && abs(p->getY() - squirtY) <= 3)
+            {
+                p->takeDamage(waterSpray);
+                hit = true;
+            }
+        }
 
-        if (!world->getIceManager()->checkIce(squirtX, squirtY) || world->squirtTargets(BB, this))
+        if (hit)
         {
             setDead();
             return;
@@ -1179,6 +1381,7 @@ void Squirt::doSomething()
 
         moveTo(squirtX, squirtY);
         m_movesLeft--;
+        m_clearSteps--;
     }
     else
     {
@@ -1188,6 +1391,29 @@ void Squirt::doSomething()
 
 void Squirt::takeDamage(DamageSource src) { return; }
 
+void Squirt::saveState(ActorRecord& r)
+{
+    Actor::saveState(r);
+    r.kind = SNAP_SQUIRT;
+    r.fields[0] = m_movesLeft;
+    r.fields[1] = m_clearSteps;
+    r.fields[2] = firstRun;
+}
+
+void Squirt::restoreState(const ActorRecord& r)
+{
+    Actor::restoreState(r);
+    m_movesLeft = r.fields[0];
+    m_clearSteps = r.fields[1];
+    firstRun = r.fields[2] != 0;
+
+    // the targets are pointers into the old world, so look again on the
+    // next move; no built grid has version 0
+    m_targets.clear();
+    m_gridVersion = 0;
+    m_protesterGeneration = 0;
+}
+
 Squirt::~Squirt()
 {
 
@@ -1211,8 +1437,8 @@ Item::Item(int imageID,
         1,
         false,
         true),
-    m_hasBeenPickedUp(false),
-    m_state(state)
+    m_state(state),
+    m_hasBeenPickedUp(false)
 {
 
 }
@@ -1265,55 +1491,97 @@ int Item::getTempTicksLeft()
     return m_tempLifetime;
 }
 
+void Item::playerInRevealRange()
+{
+    setVisible(true);
+    setPickedUp();
+}
+
+void Item::playerInPickupRange()
+{
+    return;
+}
+
+void Item::saveState(ActorRecord& r)
+{
+    Actor::saveState(r);
+    r.fields[0] = m_tempLifetime;
+    r.fields[1] = m_state;
+    r.fields[2] = m_hasBeenPickedUp;
+}
+
+void Item::restoreState(const ActorRecord& r)
+{
+    Actor::restoreState(r);
+    m_tempLifetime = r.fields[0];
+    m_hasBeenPickedUp = r.fields[2] != 0;
+
+    // the state is fixed at construction, where it decides the triggers
+}
+
 OilBarrel::OilBarrel(int x, int y)
     : Item(IID_BARREL, x, y, right, SIZE_NORMAL, 2, Item::States::Permanent)
 {
     setVisible(false);
+    setOccupant(OCC_BARREL);
     setTempLifetime();
+    getWorld()->getTriggers()->add(this, 6);
 }
 
-OilBarrel::~OilBarrel()
+void OilBarrel::saveState(ActorRecord& r)
 {
+    Item::saveState(r);
+    r.kind = SNAP_BARREL;
+}
 
+OilBarrel::~OilBarrel()
+{
+    getWorld()->getTriggers()->remove(this);
 }
 
 void OilBarrel::ItemDoSomething()
 {
-    StudentWorld* world = getWorld();
-
-    double x1 = world->getPlayer()->getX() + 1.5;
-    double y1 = world->getPlayer()->getY() + 1.5;
-
-    double distToPlayerSquared = world->getDistSquared(getX() + 1.5, getY() + 1.5, x1, y1);
+    // revealing and collecting are driven by the player's moves
+    return;
+}
 
-    if (distToPlayerSquared <= 36.0 && !hasBeenPickedUp())
-    {
-        setVisible(true);
-        setPickedUp();
-        return;
-    }
+void OilBarrel::playerInPickupRange()
+{
+    StudentWorld* world = getWorld();
 
-    if (getBB().intersects(world->getPlayer()->getBB()))
-    {
-        world->playSound(SOUND_FOUND_OIL);
-        world->increaseScore(1000);
+    world->playSound(SOUND_FOUND_OIL);
+    world->increaseScore(1000);
 
-        world->decBarrelCount();
+    world->pickupBarrel(getX(), getY());
 
-        setDead();
-    }
+    setDead();
 }
 
 GoldNugget::GoldNugget(int x, int y, Item::States state)
     : Item(IID_GOLD, x, y, right, SIZE_NORMAL, 2, state)
 {
     setVisible(getState() == Permanent ? false : true);
+    setOccupant(OCC_GOLD);
     setTempLifetime();
+
+    if (getState() == Permanent)
+    {
+        getWorld()->getTriggers()->add(this, 6);
+    }
 }
 
-GoldNugget::~GoldNugget()
+void GoldNugget::saveState(ActorRecord& r)
 {
+    Item::saveState(r);
+    r.kind = SNAP_GOLD;
+}
 
+GoldNugget::~GoldNugget()
+{
+    if (getState() == Permanent)
+    {
+        getWorld()->getTriggers()->remove(this);
+    }
 }
 
 void GoldNugget::ItemDoSomething()
@@ -1321,27 +1589,7 @@ void GoldNugget::ItemDoSomething()
     StudentWorld* world = getWorld();
     States state = getState();
 
-    double posX = world->getPlayer()->getX() + 1.5;
-    double posY = world->getPlayer()->getY() + 1.5;
-
-    double distToPlayerSquared = world->getDistSquared(getX() + 1.5, getY() + 1.5, x1, y1);
-
-    if (distToPlayerSquared <= 36.0 && !hasBeenPickedUp() && state == Permanent)
-    {
-        setVisible(true);
-        setPickedUp();
-        return;
-    }
-
-    if (getBB().intersects(world->getPlayer()->getBB()) && state == Permanent)
-    {
-        world->playSound(SOUND_GOT_GOODIE);
-        world->increaseScore(10);
-
-        world->getPlayer()->gotGoldNugget();
-
-        setDead();
-    }
+    // permanent nuggets are revealed and collected through the trigger registry
 
     if (state == Temporary)
     {
@@ -1364,6 +1612,18 @@ void GoldNugget::ItemDoSomething()
     }
 }
 
+void GoldNugget::playerInPickupRange()
+{
+    StudentWorld* world = getWorld();
+
+    world->playSound(SOUND_GOT_GOODIE);
+    world->increaseScore(10);
+
+    world->getPlayer()->gotGoldNugget();
+
+    setDead();
+}
+
 
 SonarKit::SonarKit()
     : Item(IID_SONAR, 0, 60, right, SIZE_NORMAL, 2, Item::States::Temporary)
@@ -1375,6 +1635,12 @@ SonarKit::SonarKit()
     setTempLifetime(std::max(100, 300 - level * 10));
 }
 
+void SonarKit::saveState(ActorRecord& r)
+{
+    Item::saveState(r);
+    r.kind = SNAP_SONAR;
+}
+
 SonarKit::~SonarKit()
 {
 
@@ -1399,13 +1665,20 @@ void SonarKit::ItemDoSomething()
 
 
 WaterPool::WaterPool(int x, int y)
-    :Item(waterPool, x, y, right, SIZE_NORMAL, 2, Item::States::Temporary)
+    :Item(IID_WATER_POOL, x, y, right, SIZE_NORMAL, 2, Item::States::Temporary)
 {
     setVisible(true);
+    setOccupant(OCC_WATER);
     int level = getWorld()->getLevel();
     setTempLifetime(std::max(100, 300 - level * 10));
 }
 
+void WaterPool::saveState(ActorRecord& r)
+{
+    Item::saveState(r);
+    r.kind = SNAP_WATER;
+}
+
 WaterPool::~WaterPool()
 {
 }
@@ -2,7 +2,12 @@
 #define ACTOR_H_
 
 #include "GraphObject.h"
+#include "PackedPath.h"
+#include "IceManager.h"
+#include "OccupancyGrid.h"
+#include "WorldSnapshot.h"
 #include <string>
+#include <vector>
 /*
  *
  *
@@ -47,7 +52,7 @@ public:
     Point getAdjUp() const;
     Point getAdjRight() const;
     Point getAdjDown() const;
-    Point& operator=(Point& p);
+    Point& operator=(const Point& p);
     bool operator==(Point& p);
     bool operator!=(Point& p);
     bool isValid() const;
@@ -87,6 +92,7 @@ public:
     Actor(int imageID,
         int startX,
         int startY,
+        Direction dir,
         double size,
         unsigned int depth,
         int health,
@@ -107,12 +113,30 @@ public:
     void decHealth();
     void decHealth(int i);
     int getTicksAlive() const;
+    void setSlot(int slot);
+    int getSlot() const;
+
+    // The actor's record in the world's snapshots, or -1 before its first.
+    void setSnapshotSlot(int slot);
+    int getSnapshotSlot() const;
+
+    // Keeps the world's occupancy grid in step with where the actor is.
+    void moveTo(int x, int y);
+    void setOccupant(Occupant type);
+
+    // Snapshot support: each class writes its own fields after its base's
+    // and reads them back the same way.
+    virtual void saveState(ActorRecord& r);
+    virtual void restoreState(const ActorRecord& r);
     virtual ~Actor();
 
 private:
     virtual void doSomething() = 0;
     BoundingBox m_BB;
     int m_ticksAlive;
+    int m_slot;
+    int m_snapshotSlot;
+    Occupant m_occupant;
     int m_health;
     int m_iFrames;
     bool m_isAlive;
@@ -121,22 +145,6 @@ private:
 
 };
 
-class HardcoreProtester : public Protester
-{
-public:
-
-    HardcoreProtester(int x = 60, int y = 60);
-    virtual ~HardcoreProtester();
-
-private:
-
-    virtual int getGiveUpPoints();
-    virtual void pathTowardsPlayer();
-    virtual void foundGold();
-    std::string m_pathToPlayer;
-    std::size_t m_maxPathSize;
-};
-
 class Iceman : public Actor
 {
 private:
@@ -144,9 +152,10 @@ private:
     int m_numGoldNuggets;
     int m_numSquirts;
 public:
-    Iceman(int imageID = 0,
+    Iceman(int imageID = IID_PLAYER,
         int startX = 30,
         int startY = 60,
+        Direction dir = right,
         double size = 1.0,
         unsigned int depth = 0,
         int health = 10,
@@ -161,6 +170,9 @@ public:
     int getNumSquirts();
     int getNumSonarKits();
     int getNumGoldNuggets();
+    void moveTo(int x, int y);
+    virtual void saveState(ActorRecord& r);
+    virtual void restoreState(const ActorRecord& r);
     virtual ~Iceman();
 
 };
@@ -179,16 +191,32 @@ public:
     virtual void doSomething();
     virtual void takeDamage(DamageSource src);
     virtual void foundGold() = 0;
+
+    // Hands over a route asked for through the world's PathRequestQueue,
+    // planned against the given grid version.
+    void receivePath(PackedPath& path, unsigned int gridVersion);
+
+    // The route left to walk, for snapshots, which keep it after the
+    // records as it can be any length (see WorldSnapshot.h).
+    int getPathLength() const;
+    void savePath(unsigned long long* out) const;
+    void loadPath(const unsigned long long* steps, int n);
+    virtual void saveState(ActorRecord& r);
+    virtual void restoreState(const ActorRecord& r);
     virtual ~Protester();
 
 protected:
+    void roam();
+
     int m_stepsInCurrDir;
     int m_ticksSinceAxisSwap;
     int m_nonShoutingActions;
     int m_restingTickCount;
     int m_stunTicksLeft;
 
-    std::string m_pathOut;
+    PackedPath m_pathOut;
+    unsigned int m_pathVersion;
+    bool m_awaitingPath;
     States m_state;
 
     bool m_isBribed;
@@ -203,10 +231,27 @@ private:
 
 public:
     RegularProtester(int x = 60, int y = 60);
+    virtual void saveState(ActorRecord& r);
     virtual ~RegularProtester();
 
 };
 
+class HardcoreProtester : public Protester
+{
+public:
+
+    HardcoreProtester(int x = 60, int y = 60);
+    virtual ~HardcoreProtester();
+
+private:
+
+    virtual int getGiveUpPoints();
+    virtual void pathTowardsPlayer();
+    virtual void foundGold();
+    virtual void saveState(ActorRecord& r);
+    std::size_t m_maxPathSize;
+};
+
 class Ice : public Actor
 {
 public:
@@ -217,37 +262,59 @@ public:
     virtual ~Ice();
 };
 
-class Boulder : public Actor
+// A resting boulder watches the row of ice under it and does nothing until
+// that row is dug clear.
+class Boulder : public Actor, public IceWatcher
 {
 private:
+    int findLandingRow();
+    void settle();
+
     int m_ticksUnstable;
     bool m_isStable;
     bool m_isFalling;
+    int m_startY;
+    int m_landingY;
 public:
-    Boulder(StudentWorld* world, int startX, int startY);
-    virtual void move();
-    virtual bool canActorsPassThroughMe() const;
+    Boulder(int startX, int startY);
     virtual void doSomething();
+    virtual void takeDamage(DamageSource src);
+    virtual void iceCleared(int y);
+    virtual void saveState(ActorRecord& r);
+    virtual void restoreState(const ActorRecord& r);
     virtual ~Boulder();
 };
 
+// A squirt works out when it is fired how far it can travel and which
+// protesters could get in its way, then plays that out a cell per tick. When
+// the map changes it reads its own run again, which is O(1); it looks for
+// protesters again only if that run grows or the set of protesters changes.
 class Squirt : public Actor
 {
 private:
+    void resolveTrajectory();
+    void recheckRun();
+
     int m_movesLeft;
+    int m_clearSteps;
+    unsigned int m_gridVersion;
+    unsigned int m_protesterGeneration;
+    std::vector<Protester*> m_targets;
     bool firstRun;
 public:
-    Squirt(StudentWorld* world, int startX, int startY, Direction startDir);
+    Squirt(int startX, int startY, Direction startDir);
 
-    virtual void move();
     virtual void takeDamage(DamageSource src);
     virtual void doSomething();
+    virtual void saveState(ActorRecord& r);
+    virtual void restoreState(const ActorRecord& r);
     virtual ~Squirt();
 };
 
 
 class Item : public Actor
 {
+public:
     enum States { Permanent, Temporary };
 private:
     virtual void ItemDoSomething() = 0;
@@ -271,6 +338,10 @@ public:
     States getState() const;
     void setTempLifetime(int ticks = 100);
     int getTempTicksLeft();
+    virtual void playerInRevealRange();
+    virtual void playerInPickupRange();
+    virtual void saveState(ActorRecord& r);
+    virtual void restoreState(const ActorRecord& r);
 };
 
 class OilBarrel : public Item
@@ -280,6 +351,8 @@ private:
 
 public:
     OilBarrel(int x, int y);
+    virtual void playerInPickupRange();
+    virtual void saveState(ActorRecord& r);
     ~OilBarrel();
 };
 
@@ -289,9 +362,22 @@ private:
     virtual void ItemDoSomething();
 public:
     GoldNugget(int x, int y, States state);
+    virtual void playerInPickupRange();
+    virtual void saveState(ActorRecord& r);
     ~GoldNugget();
 };
 
+class SonarKit : public Item
+{
+private:
+    virtual void ItemDoSomething();
+
+public:
+    SonarKit();
+    virtual void saveState(ActorRecord& r);
+    ~SonarKit();
+};
+
 class WaterPool : public Item
 {
 private:
@@ -299,8 +385,7 @@ private:
 
 public:
     WaterPool(int x, int y);
-    WaterPool(StudentWorld* world, int startX, int startY);
-    virtual void move();
+    virtual void saveState(ActorRecord& r);
     ~WaterPool();
 };
 
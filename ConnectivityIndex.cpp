@@ -0,0 +1,132 @@
+#include "ConnectivityIndex.h"
+
+ConnectivityIndex::ConnectivityIndex()
+{
+    for (int i = 0; i != SIZE * SIZE; i++)
+        m_open[i] = false;
+
+    reset();
+}
+
+void ConnectivityIndex::reset()
+{
+    for (int i = 0; i != SIZE * SIZE; i++)
+    {
+        m_parent[i] = i;
+        m_rank[i] = 0;
+    }
+
+    m_dirty = false;
+}
+
+void ConnectivityIndex::setOpen(int x, int y, bool open)
+{
+    int i = indexOf(x, y);
+
+    if (m_open[i] && !open)
+        m_dirty = true;
+
+    m_open[i] = open;
+}
+
+bool ConnectivityIndex::isOpen(int x, int y) const
+{
+    if (x < 0 || x >= SIZE || y < 0 || y >= SIZE)
+        return false;
+
+    return m_open[indexOf(x, y)];
+}
+
+int ConnectivityIndex::find(int i)
+{
+    // path halving, leaving cells that already point at their root alone
+    while (m_parent[i] != i)
+    {
+        int grandparent = m_parent[m_parent[i]];
+
+        if (m_parent[i] != grandparent)
+            m_parent[i] = grandparent;
+        i = grandparent;
+    }
+    return i;
+}
+
+void ConnectivityIndex::unite(int a, int b)
+{
+    a = find(a);
+    b = find(b);
+
+    if (a == b)
+        return;
+
+    if (m_rank[a] < m_rank[b])
+    {
+        int t = a;
+        a = b;
+        b = t;
+    }
+
+    m_parent[b] = a;
+
+    if (m_rank[a] == m_rank[b])
+        m_rank[a]++;
+}
+
+void ConnectivityIndex::mergeWithNeighbours(int x, int y)
+{
+    if (m_dirty || !isOpen(x, y))
+        return;
+
+    int i = indexOf(x, y);
+
+    if (isOpen(x - 1, y))
+        unite(i, indexOf(x - 1, y));
+    if (isOpen(x + 1, y))
+        unite(i, indexOf(x + 1, y));
+    if (isOpen(x, y - 1))
+        unite(i, indexOf(x, y - 1));
+    if (isOpen(x, y + 1))
+        unite(i, indexOf(x, y + 1));
+}
+
+void ConnectivityIndex::rebuild()
+{
+    reset();
+
+    for (int x = 0; x != SIZE; x++)
+        for (int y = 0; y != SIZE; y++)
+        {
+            if (!isOpen(x, y))
+                continue;
+
+            if (isOpen(x + 1, y))
+                unite(indexOf(x, y), indexOf(x + 1, y));
+            if (isOpen(x, y + 1))
+                unite(indexOf(x, y), indexOf(x, y + 1));
+        }
+}
+
+bool ConnectivityIndex::isConnected(int x1, int y1, int x2, int y2)
+{
+    if (!isOpen(x1, y1) || !isOpen(x2, y2))
+        return false;
+
+    if (m_dirty)
+        rebuild();
+
+    return find(indexOf(x1, y1)) == find(indexOf(x2, y2));
+}
+
+void ConnectivityIndex::compress()
+{
+    if (m_dirty)
+        rebuild();
+
+    for (int i = 0; i != SIZE * SIZE; i++)
+    {
+        int root = find(i);
+
+        if (m_parent[i] != root)
+            m_parent[i] = root;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef CONNECTIVITYINDEX_H_
+#define CONNECTIVITYINDEX_H_
+
+// Connected components of the open anchor cells, kept in a union-find.
+// Digging only ever joins regions, so newly opened cells are merged in place.
+// A cell closing (a boulder coming to rest) can split a region, which a
+// union-find can't undo, so that just marks the index for a rebuild on the
+// next query.
+class ConnectivityIndex
+{
+public:
+    ConnectivityIndex();
+
+    void reset();
+    void setOpen(int x, int y, bool open);
+    bool isOpen(int x, int y) const;
+
+    // Joins the cell with each open 4-neighbour; call after setOpen(x, y, true).
+    void mergeWithNeighbours(int x, int y);
+
+    void invalidate()
+    {
+        m_dirty = true;
+    }
+
+    bool isConnected(int x1, int y1, int x2, int y2);
+
+    // Finishes any pending rebuild and points every cell straight at its
+    // root, after which queries write nothing until the next change.
+    void compress();
+
+private:
+    static const int SIZE = 61;
+
+    static int indexOf(int x, int y)
+    {
+        return x * SIZE + y;
+    }
+
+    int find(int i);
+    void unite(int a, int b);
+    void rebuild();
+
+    int m_parent[SIZE * SIZE];
+    unsigned char m_rank[SIZE * SIZE];
+    bool m_open[SIZE * SIZE];
+    bool m_dirty;
+};
+
+#endif // CONNECTIVITYINDEX_H_
@@ -0,0 +1,11 @@
+#include "DistanceKernel.h"
+
+void computeDistancesSquared(const int* xs, const int* ys, int n, int px, int py, int* out)
+{
+    for (int i = 0; i < n; i++)
+    {
+        int dx = xs[i] - px;
+        int dy = ys[i] - py;
+        out[i] = dx * dx + dy * dy;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef DISTANCEKERNEL_H_
+#define DISTANCEKERNEL_H_
+
+// Proximity rules are written as "within r units", measured centre to centre.
+// A size 1.0 sprite anchored at x has its centre at x + 1.5, so working on
+// doubled coordinates (2x + 3) keeps every centre on an integer and lets all
+// of the radius 3/4/6/12 tests be done with integer squared distances.
+
+inline int toDoubledCentre(int anchor)
+{
+    return 2 * anchor + 3;
+}
+
+inline int toDoubledRadiusSquared(int radius)
+{
+    return 4 * radius * radius;
+}
+
+inline int doubledDistSquared(int x1, int y1, int x2, int y2)
+{
+    int dx = toDoubledCentre(x1) - toDoubledCentre(x2);
+    int dy = toDoubledCentre(y1) - toDoubledCentre(y2);
+    return dx * dx + dy * dy;
+}
+
+// Batched form of doubledDistSquared(): out[i] = |(xs[i], ys[i]) - (px, py)|^2
+// for n doubled centres. Inputs and output are separate contiguous arrays
+// with no branches in the loop so the compiler can vectorize it.
+void computeDistancesSquared(const int* xs, const int* ys, int n, int px, int py, int* out);
+
+#endif // DISTANCEKERNEL_H_
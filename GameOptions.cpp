@@ -0,0 +1,145 @@
+#include "GameOptions.h"
+#include <string>
+#include <cstring>
+#include <cstdlib>
+using namespace std;
+
+const GameOptions::Option GameOptions::OPTIONS[] =
+{
+    { "-level", PATH, &GameOptions::m_levelFile, nullptr, nullptr, nullptr },
+    { "-pack", PATH, &GameOptions::m_levelPack, nullptr, nullptr, nullptr },
+    { "-restore", PATH, &GameOptions::m_restorePath, nullptr, nullptr, nullptr },
+    { "-record", PATH, &GameOptions::m_recordPath, nullptr, nullptr, nullptr },
+    { "-replay", PATH, &GameOptions::m_replayPath, nullptr, nullptr, nullptr },
+    { "-speed", SPEED, nullptr, nullptr, &GameOptions::m_replaySpeed, nullptr },
+    { "-keyframes", COUNT, nullptr, &GameOptions::m_keyframeInterval, nullptr, nullptr },
+    { "-seek", COUNT, nullptr, &GameOptions::m_seekTick, nullptr, nullptr },
+    { "-rewind", COUNT, nullptr, &GameOptions::m_rewindTicks, nullptr, nullptr },
+    { "-practice", SWITCH, nullptr, nullptr, nullptr, &GameOptions::m_practiceMode },
+    { "-broadcast", PATH, &GameOptions::m_broadcastPath, nullptr, nullptr, nullptr },
+    { "-rle", SWITCH, nullptr, nullptr, nullptr, &GameOptions::m_compressBroadcast },
+    { "-spectate", PATH, &GameOptions::m_spectatePath, nullptr, nullptr, nullptr },
+};
+
+const int GameOptions::NUM_OPTIONS = sizeof(OPTIONS) / sizeof(OPTIONS[0]);
+
+GameOptions::GameOptions()
+    : m_replaySpeed(1),
+    m_keyframeInterval(1000),
+    m_seekTick(0),
+    m_rewindTicks(0),
+    m_practiceMode(false),
+    m_compressBroadcast(false)
+{
+}
+
+string GameOptions::getLevelFile() const
+{
+    return m_levelFile;
+}
+
+string GameOptions::getLevelPack() const
+{
+    return m_levelPack;
+}
+
+string GameOptions::getRestorePath() const
+{
+    return m_restorePath;
+}
+
+string GameOptions::getRecordPath() const
+{
+    return m_recordPath;
+}
+
+string GameOptions::getReplayPath() const
+{
+    return m_replayPath;
+}
+
+double GameOptions::getReplaySpeed() const
+{
+    return m_replaySpeed;
+}
+
+int GameOptions::getKeyframeInterval() const
+{
+    return m_keyframeInterval;
+}
+
+int GameOptions::getSeekTick() const
+{
+    return m_seekTick;
+}
+
+int GameOptions::getRewindTicks() const
+{
+    // practice needs something to wind back to
+    return m_practiceMode && m_rewindTicks == 0 ? 1200 : m_rewindTicks;
+}
+
+bool GameOptions::isPracticeMode() const
+{
+    return m_practiceMode;
+}
+
+string GameOptions::getBroadcastPath() const
+{
+    return m_broadcastPath;
+}
+
+bool GameOptions::compressBroadcast() const
+{
+    return m_compressBroadcast;
+}
+
+string GameOptions::getSpectatePath() const
+{
+    return m_spectatePath;
+}
+
+void GameOptions::parseArgs(int& argc, char* argv[])
+{
+    int kept = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const Option* option = nullptr;
+
+        for (int j = 0; j != NUM_OPTIONS && option == nullptr; j++)
+            if (strcmp(argv[i], OPTIONS[j].flag) == 0)
+                option = &OPTIONS[j];
+
+        // an option missing its value is passed on untouched
+        if (option == nullptr || (option->type != SWITCH && i + 1 >= argc))
+        {
+            argv[kept++] = argv[i];
+            continue;
+        }
+
+        switch (option->type)
+        {
+        case PATH:
+            this->*option->path = argv[++i];
+            break;
+        case COUNT:
+        {
+            int n = atoi(argv[++i]);
+            this->*option->count = n > 0 ? n : 0;
+            break;
+        }
+        case SPEED:
+        {
+            double speed = atof(argv[++i]);
+            this->*option->speed = speed > 0 ? speed : 1;
+            break;
+        }
+        default:
+            this->*option->on = true;
+            break;
+        }
+    }
+
+    argc = kept;
+}
@@ -0,0 +1,119 @@
+#ifndef GAMEOPTIONS_H_
+#define GAMEOPTIONS_H_
+
+#include <string>
+
+// How the game is set up and played, from the command line. Each option is
+// one row of a table (see GameOptions.cpp), read by parseArgs().
+//
+// -level map.lvl plays a fixed binary level (see LevelFile) and
+// -pack levels.lvp plays pre-generated levels in order (see LevelPack)
+// instead of generating them; both work with or without -stress.
+// -restore world.snap starts from a saved snapshot (see WorldSnapshot).
+// -record game.rpl records the game's seed and keys (see Replay) and
+// -replay game.rpl plays them back, -speed times as fast; a replay made
+// with -level, -pack or -stress needs the same options to play back.
+// -keyframes n keeps a keyframe every n ticks of a recording (0 for none),
+// which -seek tick uses to start a replay part way through.
+// -rewind n keeps the last n ticks of play so B can wind them back (see
+// RewindBuffer), and -practice winds back instead of losing a life; neither
+// works while recording or replaying.
+// -broadcast path sends the game to a file or named pipe as it is played
+// (see SpectatorStream), run-length packed with -rle, and -spectate path
+// watches one instead of playing (see SpectatorWorld).
+class GameOptions
+{
+public:
+
+    // The fixed level to play, or empty to generate levels.
+    std::string getLevelFile() const;
+
+    // The level pack to play, or empty to generate levels.
+    std::string getLevelPack() const;
+
+    // The snapshot to start from, or empty to start a new game.
+    std::string getRestorePath() const;
+
+    // Where to record the game, or empty not to.
+    std::string getRecordPath() const;
+
+    // The replay to play instead of reading the keyboard, or empty.
+    std::string getReplayPath() const;
+
+    // Ticks a replay plays per frame in the GUI; may be fractional.
+    double getReplaySpeed() const;
+
+    // Ticks between a recording's keyframes, or 0 for none.
+    int getKeyframeInterval() const;
+
+    // The tick to start a replay from, or 0 for the beginning.
+    int getSeekTick() const;
+
+    // Ticks of play kept for winding back, or 0 for none.
+    int getRewindTicks() const;
+
+    // Whether dying winds the game back instead of costing a life.
+    bool isPracticeMode() const;
+
+    // Where to send the game for a viewer, or empty not to.
+    std::string getBroadcastPath() const;
+
+    // Whether broadcast frames are run-length packed.
+    bool compressBroadcast() const;
+
+    // The broadcast to watch instead of playing, or empty.
+    std::string getSpectatePath() const;
+
+    // Consumes the options in the table from argv so the rest can go to
+    // GLUT.
+    void parseArgs(int& argc, char* argv[]);
+
+    // Meyers singleton pattern
+    static GameOptions& getInstance()
+    {
+        static GameOptions instance;
+        return instance;
+    }
+
+private:
+    GameOptions();
+
+    // What an option's value is read as: a path, a count (negative counts
+    // as 0), a speed (anything but a positive one counts as 1), or nothing,
+    // for a switch that is on when given.
+    enum ValueType { PATH, COUNT, SPEED, SWITCH };
+
+    // One row of the table: the flag and the member it sets; only the
+    // pointer for its type is used.
+    struct Option
+    {
+        const char* flag;
+        ValueType type;
+        std::string GameOptions::* path;
+        int GameOptions::* count;
+        double GameOptions::* speed;
+        bool GameOptions::* on;
+    };
+
+    static const Option OPTIONS[];
+    static const int NUM_OPTIONS;
+
+    std::string m_levelFile;
+    std::string m_levelPack;
+    std::string m_restorePath;
+    std::string m_recordPath;
+    std::string m_replayPath;
+    double m_replaySpeed;
+    int m_keyframeInterval;
+    int m_seekTick;
+    int m_rewindTicks;
+    bool m_practiceMode;
+    std::string m_broadcastPath;
+    bool m_compressBroadcast;
+    std::string m_spectatePath;
+
+    GameOptions(const GameOptions&);
+    GameOptions& operator=(const GameOptions&);
+};
+
+#endif // GAMEOPTIONS_H_
@@ -4,8 +4,14 @@
 #include <cstdlib>
 using namespace std;
 
+  // A world with no controller (e.g. a look-ahead clone) is never shown, so
+  // it gets no keys and makes no sound.
+
 bool GameWorld::getKey(int& value)
 {
+	if (m_controller == nullptr)
+		return false;
+
 	bool gotKey = m_controller->getLastKey(value);
 
 	if (gotKey)
@@ -20,10 +26,12 @@ bool GameWorld::getKey(int& value)
 
 void GameWorld::playSound(int soundID)
 {
-	m_controller->playSound(soundID);
+	if (m_controller != nullptr)
+		m_controller->playSound(soundID);
 }
 
 void GameWorld::setGameStatText(string text)
 {
-	m_controller->setGameStatText(text);
+	if (m_controller != nullptr)
+		m_controller->setGameStatText(text);
 }
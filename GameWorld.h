@@ -72,6 +72,13 @@ public:
 	{
 		++m_level;
 	}
+
+	void restoreStats(unsigned int level, unsigned int lives, unsigned int score)
+	{
+		m_level = level;
+		m_lives = lives;
+		m_score = score;
+	}
    
 	void setController(GameController* controller)
 	{
@@ -26,17 +26,20 @@ class GraphObject
 	GraphObject(int imageID, int startX, int startY, Direction dir = right, double size = 1.0, unsigned int depth = 0)
 	 : m_imageID(imageID), m_visible(false), m_x(startX), m_y(startY),
 	   m_destX(startX), m_destY(startY), m_brightness(1.0),
-	   m_animationNumber(0), m_direction(dir), m_size(size), m_depth(depth)
+	   m_animationNumber(0), m_direction(dir), m_size(size), m_depth(depth),
+	   m_registered(!isHeadless())
 	{
 		if (m_size <= 0)
 			m_size = 1;
 
-		getGraphObjects(m_depth).insert(this);
+		if (m_registered)
+			getGraphObjects(m_depth).insert(this);
 	}
 
 	virtual ~GraphObject()
 	{
-		getGraphObjects(m_depth).erase(this);
+		if (m_registered)
+			getGraphObjects(m_depth).erase(this);
 	}
 
 	void setVisible(bool shouldIDisplay)
@@ -100,6 +103,11 @@ class GraphObject
 		return m_brightness;
 	}
 
+	unsigned int getDepth() const
+	{
+		return m_depth;
+	}
+
 	unsigned int getAnimationNumber() const
 	{
 		return m_animationNumber;
@@ -118,6 +126,19 @@ class GraphObject
 		moveALittle(m_y, m_destY);
 	}
 
+	  // Objects made on this thread while headless is set stay out of the
+	  // display lists, so worlds cloned for look-ahead never reach the
+	  // renderer.
+	static bool isHeadless()
+	{
+		return headlessFlag();
+	}
+
+	static void setHeadless(bool headless)
+	{
+		headlessFlag() = headless;
+	}
+
 	static std::set<GraphObject*>& getGraphObjects(unsigned int layer)
 	{
 		static std::set<GraphObject*> graphObjects[NUM_LAYERS];
@@ -143,6 +164,13 @@ class GraphObject
 	Direction	m_direction;
 	double	m_size;
 	int		m_depth;
+	bool	m_registered;
+
+	static bool& headlessFlag()
+	{
+		static thread_local bool headless = false;
+		return headless;
+	}
 
 	void moveALittle(double& from, double& to)
 	{
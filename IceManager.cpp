@@ -0,0 +1,314 @@
+#include "IceManager.h"
+#include "Actor.h"
+#include <algorithm>
+using namespace std;
+
+IceManager::Field::Field()
+    : iceCount(0), sumsDirtyFrom(0)
+{
+    for (int y = 0; y != 64; y++)
+        rows[y] = 0;
+
+    for (int i = 0; i != 61 * 61; i++)
+        isClearAnchor[i] = false;
+}
+
+// One empty field shared by every manager that hasn't been filled, so
+// making or clearing an IceManager copies nothing.
+shared_ptr<IceManager::Field> IceManager::emptyField()
+{
+    static shared_ptr<Field> empty = make_shared<Field>();
+    return empty;
+}
+
+IceManager::IceManager()
+    : m_field(emptyField()), m_initialIceCount(0)
+{
+    for (int x = 0; x != 64; x++)
+        for (int y = 0; y != 64; y++)
+            m_ice[x][y] = nullptr;
+}
+
+IceManager::~IceManager()
+{
+    clear();
+
+    for (size_t i = 0; i != m_spareIce.size(); i++)
+        delete m_spareIce[i];
+}
+
+unsigned long long IceManager::boxMask(int x)
+{
+    return 0xFULL << x;
+}
+
+void IceManager::getInitialRows(unsigned long long rows[64])
+{
+    unsigned long long shaft = 0xFULL << 30;
+
+    for (int y = 0; y != 64; y++)
+        rows[y] = y >= 60 ? 0 : (y < 4 ? ~0ULL : ~shaft);
+}
+
+void IceManager::fill()
+{
+    unsigned long long rows[64];
+    getInitialRows(rows);
+    fill(rows);
+}
+
+void IceManager::fill(const unsigned long long rows[64])
+{
+    clear();
+
+    Field& f = edit();
+
+    for (int y = 0; y != 64; y++)
+    {
+        f.rows[y] = rows[y];
+
+        for (int x = 0; x != 64; x++)
+        {
+            if (!((rows[y] >> x) & 1))
+                continue;
+
+            f.iceCount++;
+
+            // worlds that are never drawn only need the masks
+            if (GraphObject::isHeadless())
+                continue;
+
+            if (m_spareIce.empty())
+                m_ice[x][y] = new Ice(x, y);
+            else
+            {
+                m_ice[x][y] = m_spareIce.back();
+                m_spareIce.pop_back();
+                m_ice[x][y]->moveTo(x, y);
+                m_ice[x][y]->setVisible(true);
+            }
+        }
+    }
+
+    m_initialIceCount = f.iceCount;
+    f.sumsDirtyFrom = 0;
+
+    indexClearAnchors(0, 0, 60, 60);
+}
+
+void IceManager::share(IceManager& other)
+{
+    clear();
+
+    // a shared field never has stale sums, so nothing writes to it in place
+    if (other.m_field->sumsDirtyFrom < 64)
+        other.refreshSums();
+
+    m_field = other.m_field;
+    m_initialIceCount = other.m_initialIceCount;
+}
+
+IceManager::Field& IceManager::edit()
+{
+    if (m_field.use_count() != 1)
+        m_field = make_shared<Field>(*m_field);
+
+    return *m_field;
+}
+
+void IceManager::recycle(Ice* ice)
+{
+    ice->setVisible(false);
+    m_spareIce.push_back(ice);
+}
+
+void IceManager::clear()
+{
+    for (int x = 0; x != 64; x++)
+        for (int y = 0; y != 64; y++)
+        {
+            if (m_ice[x][y] != nullptr)
+                recycle(m_ice[x][y]);
+            m_ice[x][y] = nullptr;
+        }
+
+    for (int y = 0; y != 64; y++)
+        m_watchers[y].clear();
+
+    m_field = emptyField();
+    m_initialIceCount = 0;
+}
+
+bool IceManager::hasIce(int x, int y) const
+{
+    if (x < 0 || x > 63 || y < 0 || y > 63)
+        return false;
+
+    return (m_field->rows[y] >> x) & 1;
+}
+
+bool IceManager::checkIce(int x, int y) const
+{
+    if (x < 0 || x > 60 || y < 0 || y > 60)
+        return false;
+
+    unsigned long long mask = boxMask(x);
+    const unsigned long long* rows = m_field->rows;
+
+    return ((rows[y] | rows[y + 1] | rows[y + 2] | rows[y + 3]) & mask) == 0;
+}
+
+bool IceManager::clearIce(int x, int y)
+{
+    bool rv = false;
+
+    if (x < -3 || x > 63)
+        return false;
+
+    for (int j = y; j != y + 4; j++)
+    {
+        if (j < 0 || j > 63)
+            continue;
+
+        unsigned long long dug = m_field->rows[j] & (x >= 0 ? boxMask(x) : (0xFULL >> -x));
+
+        if (dug == 0)
+            continue;
+
+        Field& f = edit();
+        f.rows[j] &= ~dug;
+        rv = true;
+
+        for (; dug != 0; dug &= dug - 1)
+            f.iceCount--;
+
+        if (j < f.sumsDirtyFrom)
+            f.sumsDirtyFrom = j;
+
+        for (int i = x; i != x + 4; i++)
+        {
+            if (i >= 0 && i <= 63 && m_ice[i][j] != nullptr)
+            {
+                recycle(m_ice[i][j]);
+                m_ice[i][j] = nullptr;
+            }
+        }
+
+        // backwards, since a watcher usually stops watching when told
+        for (size_t k = m_watchers[j].size(); k-- != 0;)
+            m_watchers[j][k]->iceCleared(j);
+    }
+
+    // only anchors whose box overlaps the dug one can have become clear
+    if (rv)
+        indexClearAnchors(x - 3, y - 3, x + 3, y + 3);
+
+    return rv;
+}
+
+void IceManager::indexClearAnchors(int x1, int y1, int x2, int y2)
+{
+    Field& f = edit();
+
+    for (int x = max(x1, 0); x <= min(x2, 60); x++)
+        for (int y = max(y1, 0); y <= min(y2, 60); y++)
+        {
+            int anchor = x * 61 + y;
+
+            if (!f.isClearAnchor[anchor] && checkIce(x, y))
+            {
+                // kept sorted, so which spot an index picks depends only on
+                // the field and not the order it was dug in
+                f.isClearAnchor[anchor] = true;
+                f.clearAnchors.insert(lower_bound(f.clearAnchors.begin(), f.clearAnchors.end(), anchor), anchor);
+            }
+        }
+}
+
+void IceManager::getClearAnchor(int i, int& x, int& y) const
+{
+    x = m_field->clearAnchors[i] / 61;
+    y = m_field->clearAnchors[i] % 61;
+}
+
+void IceManager::refreshSums()
+{
+    Field& f = edit();
+
+    for (int y = f.sumsDirtyFrom; y < 64; y++)
+    {
+        if (y == 0)
+            for (int x = 0; x <= 64; x++)
+                f.sums[0][x] = 0;
+
+        int rowCount = 0;
+        f.sums[y + 1][0] = 0;
+
+        for (int x = 0; x != 64; x++)
+        {
+            rowCount += (f.rows[y] >> x) & 1;
+            f.sums[y + 1][x + 1] = f.sums[y][x + 1] + rowCount;
+        }
+    }
+
+    f.sumsDirtyFrom = 64;
+}
+
+int IceManager::countIce(int x, int y, int w, int h)
+{
+    int x1 = max(x, 0);
+    int y1 = max(y, 0);
+    int x2 = min(x + w, 64);
+    int y2 = min(y + h, 64);
+
+    if (x1 >= x2 || y1 >= y2)
+        return 0;
+
+    if (m_field->sumsDirtyFrom < 64)
+        refreshSums();
+
+    const Field& f = *m_field;
+    return f.sums[y2][x2] - f.sums[y1][x2] - f.sums[y2][x1] + f.sums[y1][x1];
+}
+
+double IceManager::getPercentDug() const
+{
+    if (m_initialIceCount == 0)
+        return 0;
+
+    return 100.0 * (m_initialIceCount - m_field->iceCount) / m_initialIceCount;
+}
+
+bool IceManager::isRowClear(int x, int y) const
+{
+    if (y < 0 || y > 63)
+        return false;
+
+    return (m_field->rows[y] & boxMask(x)) == 0;
+}
+
+int IceManager::getDropDistance(int x, int y) const
+{
+    unsigned long long mask = boxMask(x);
+    int d = 0;
+
+    while (y - d > 0 && (m_field->rows[y - d - 1] & mask) == 0)
+        d++;
+
+    return d;
+}
+
+void IceManager::watchRow(int y, IceWatcher* watcher)
+{
+    if (y >= 0 && y <= 63)
+        m_watchers[y].push_back(watcher);
+}
+
+void IceManager::unwatchRow(int y, IceWatcher* watcher)
+{
+    if (y < 0 || y > 63)
+        return;
+
+    vector<IceWatcher*>& watchers = m_watchers[y];
+    watchers.erase(remove(watchers.begin(), watchers.end(), watcher), watchers.end());
+}
@@ -0,0 +1,145 @@
+#ifndef ICEMANAGER_H_
+#define ICEMANAGER_H_
+
+#include <vector>
+#include <memory>
+
+class Ice;
+
+// Told when ice is dug out of a row it is watching, so that things resting on
+// the ice don't have to poll it every tick.
+class IceWatcher
+{
+public:
+    virtual void iceCleared(int y) = 0;
+    virtual ~IceWatcher() {}
+};
+
+// Owns the field's ice. Besides the Ice objects that get drawn, the ice is
+// kept as one 64-bit row mask per y (bit x set when (x, y) has ice) so that
+// "is this 4x4 box clear" is four mask tests instead of a scan over every
+// block of ice.
+//
+// The masks and the tables built from them live in a Field that cloned
+// worlds share until one of them digs, when that world takes its own copy.
+class IceManager
+{
+public:
+    IceManager();
+    ~IceManager();
+
+    // Fills rows 0-59 with ice, leaving the mine shaft open.
+    void fill();
+
+    // Fills exactly the cells set in rows (bit x of rows[y]).
+    void fill(const unsigned long long rows[64]);
+    void clear();
+
+    // Shares other's ice without copying it. No Ice objects are made, so
+    // this is for worlds that are never drawn.
+    void share(IceManager& other);
+
+    // The row masks fill() starts a level with.
+    static void getInitialRows(unsigned long long rows[64]);
+
+    bool hasIce(int x, int y) const;
+
+    // True when the 4x4 box anchored at (x, y) is inside the field and has
+    // no ice in it.
+    bool checkIce(int x, int y) const;
+
+    // Removes the ice under the 4x4 box anchored at (x, y). Returns true if
+    // any ice was actually dug.
+    bool clearIce(int x, int y);
+
+    // True when row y has no ice under x..x+3.
+    bool isRowClear(int x, int y) const;
+
+    // How many rows a 4-wide box anchored at (x, y) can drop before ice or
+    // the bottom of the field stops it.
+    int getDropDistance(int x, int y) const;
+
+    void watchRow(int y, IceWatcher* watcher);
+    void unwatchRow(int y, IceWatcher* watcher);
+
+    unsigned long long getRow(int y) const
+    {
+        return m_field->rows[y];
+    }
+
+    int getIceCount() const
+    {
+        return m_field->iceCount;
+    }
+
+    // Ice in the w x h rectangle anchored at (x, y), clipped to the field,
+    // in O(1) from a summed-area table.
+    int countIce(int x, int y, int w, int h);
+
+    // Share of the ice laid by fill() that has been dug out, 0-100.
+    double getPercentDug() const;
+
+    // What getPercentDug() measures against; a restored snapshot sets it
+    // back after refilling the field.
+    int getInitialIceCount() const
+    {
+        return m_initialIceCount;
+    }
+
+    void setInitialIceCount(int count)
+    {
+        m_initialIceCount = count;
+    }
+
+    // Every anchor whose 4x4 box is free of ice, kept up to date as ice is
+    // dug, so a uniformly random clear spot is one index away.
+    int getClearAnchorCount() const
+    {
+        return m_field->clearAnchors.size();
+    }
+
+    void getClearAnchor(int i, int& x, int& y) const;
+
+private:
+    struct Field
+    {
+        Field();
+
+        unsigned long long rows[64];
+        int iceCount;
+
+        // sums[y][x] is the ice in rows below y and columns left of x.
+        // Digging only marks the lowest changed row; that row and every one
+        // above it are rebuilt on the next count.
+        int sums[65][65];
+        int sumsDirtyFrom;
+
+        // anchors packed as x * 61 + y, in order; ice never comes back, so
+        // they are only ever added until the next fill()
+        std::vector<int> clearAnchors;
+        bool isClearAnchor[61 * 61];
+    };
+
+    static unsigned long long boxMask(int x);
+    static std::shared_ptr<Field> emptyField();
+
+    // The field, copied first if another world is sharing it.
+    Field& edit();
+    void refreshSums();
+    void recycle(Ice* ice);
+    void indexClearAnchors(int x1, int y1, int x2, int y2);
+
+    std::shared_ptr<Field> m_field;
+    Ice* m_ice[64][64];
+
+    // dug-out Ice objects, hidden and kept for the next fill() rather than
+    // freed and reallocated thousands at a time between levels
+    std::vector<Ice*> m_spareIce;
+    int m_initialIceCount;
+    std::vector<IceWatcher*> m_watchers[64];
+
+    IceManager(const IceManager&);
+    IceManager& operator=(const IceManager&);
+};
+
+#endif // ICEMANAGER_H_
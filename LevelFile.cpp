@@ -0,0 +1,351 @@
+#include "LevelFile.h"
+#include "IceManager.h"
+#include <sstream>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+static_assert(sizeof(LevelFileHeader) == 560, "level file header layout changed");
+static_assert(sizeof(Placement) == 8, "placements are stored in the file as two 32-bit ints");
+
+const char LEVEL_MAGIC[4] = { 'I', 'C', 'E', 'L' };
+
+// Anchors keep the whole 4x4 sprite inside the field and below the surface.
+const int MAX_ANCHOR_X = 60;
+const int MAX_ANCHOR_Y = 56;
+const int ICE_HEIGHT = 60;
+
+LevelFile::LevelFile()
+    : m_isOpen(false)
+{
+}
+
+bool LevelFile::open(const string& path, string& error)
+{
+    m_isOpen = false;
+
+    if (!m_file.open(path))
+    {
+        error = "can't open " + path;
+        return false;
+    }
+
+    if (!validate(m_file.getData(), m_file.getSize(), error))
+    {
+        m_file.close();
+        return false;
+    }
+
+    m_isOpen = true;
+    return true;
+}
+
+void LevelFile::getLevel(int level, LevelData& out) const
+{
+    if (m_isOpen)
+        copyLevel(m_file.getData(), level, out);
+}
+
+// Images are 8-byte aligned (a mapping starts on a page, and packs keep
+// every image on an 8-byte boundary), so the header and anchors are read in
+// place.
+void LevelFile::copyLevel(const unsigned char* data, int level, LevelData& out)
+{
+    const LevelFileHeader& h = *reinterpret_cast<const LevelFileHeader*>(data);
+    const Placement* p = reinterpret_cast<const Placement*>(data + sizeof(LevelFileHeader));
+
+    out.level = level;
+    out.seed = h.seed;
+    memcpy(out.iceRows, h.iceRows, sizeof(out.iceRows));
+
+    out.boulders.assign(p, p + h.nBoulders);
+    p += h.nBoulders;
+    out.gold.assign(p, p + h.nGold);
+    p += h.nGold;
+    out.barrels.assign(p, p + h.nBarrels);
+
+    out.maxProtesters = h.maxProtesters;
+    out.ticksBetweenProtesters = h.ticksBetweenProtesters;
+    out.goodieChance = h.goodieChance;
+    out.hardcoreChance = h.hardcoreChance;
+
+    // the same seed always replays the same level
+    Random rng(h.seed);
+    out.nextSeed = rng.next();
+    out.rngState = rng.next();
+}
+
+static bool inField(const Placement& p)
+{
+    return p.x >= 0 && p.x <= MAX_ANCHOR_X && p.y >= 0 && p.y <= MAX_ANCHOR_Y;
+}
+
+bool LevelFile::validate(const unsigned char* data, size_t size, string& error)
+{
+    if (size < sizeof(LevelFileHeader))
+    {
+        error = "file is too short";
+        return false;
+    }
+
+    const LevelFileHeader& h = *reinterpret_cast<const LevelFileHeader*>(data);
+    size_t nPlacements = (size_t)h.nBoulders + h.nGold + h.nBarrels;
+
+    if (memcmp(h.magic, LEVEL_MAGIC, sizeof(LEVEL_MAGIC)) != 0)
+        error = "not a level file";
+    else if (h.version != VERSION)
+        error = "unsupported level file version";
+    else if (h.fileSize != size || size != sizeof(LevelFileHeader) + nPlacements * sizeof(Placement))
+        error = "file size doesn't match its header";
+    else if (h.maxProtesters < -1 || h.ticksBetweenProtesters < -1 || h.hardcoreChance < -1 || h.hardcoreChance > 100)
+        error = "bad spawn parameters";
+    else if (h.goodieChance < -1 || h.goodieChance == 0)
+        error = "goodie chance must be at least 1";
+    else if (h.nBarrels == 0)
+        error = "a level needs at least one barrel";
+    else
+        error.clear();
+
+    if (!error.empty())
+        return false;
+
+    for (int y = ICE_HEIGHT; y != 64; y++)
+        if (h.iceRows[y] != 0)
+        {
+            error = "ice above the surface";
+            return false;
+        }
+
+    const Placement* p = reinterpret_cast<const Placement*>(data + sizeof(LevelFileHeader));
+
+    for (size_t i = 0; i != nPlacements; i++)
+    {
+        if (!inField(p[i]))
+        {
+            error = "object outside the field";
+            return false;
+        }
+
+        // boulders must start in a dug-out hole
+        if (i < h.nBoulders)
+            for (int y = p[i].y; y != p[i].y + 4; y++)
+                if ((h.iceRows[y] >> p[i].x) & 0xF)
+                {
+                    error = "boulder buried in ice";
+                    return false;
+                }
+    }
+
+    return true;
+}
+
+// Text maps are line based; # starts a comment.
+//
+//   seed 1234            level seed (game-logic randomness)
+//   protesters 6         spawn rules, as for -stress; omitted means the
+//   rate 50              normal level rule
+//   goodies 300
+//   hardcore 40
+//   boulder 12 30        an object anchored at (x, y)
+//   gold 5 4
+//   barrel 40 8
+//   map                  then 60 rows of 64 characters, top row first:
+//                        '#' ice, '.' dug out, and B, G or L marking a
+//                        boulder, gold or barrel anchored at that cell
+//
+// Without a map the field starts as in a normal level. Boulders have their
+// spot dug out automatically.
+bool LevelFile::convertText(istream& in, ostream& out, string& error)
+{
+    LevelData d;
+    d.level = 0;
+    d.seed = 0;
+    d.maxProtesters = -1;
+    d.ticksBetweenProtesters = -1;
+    d.goodieChance = -1;
+    d.hardcoreChance = -1;
+
+    unsigned long long* rows = d.iceRows;
+    IceManager::getInitialRows(rows);
+
+    vector<Placement>& boulders = d.boulders;
+    vector<Placement>& gold = d.gold;
+    vector<Placement>& barrels = d.barrels;
+
+    string line;
+    int lineNumber = 0;
+    int mapRow = -1;
+
+    while (getline(in, line))
+    {
+        lineNumber++;
+
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+
+        ostringstream where;
+        where << "line " << lineNumber << ": ";
+
+        if (mapRow >= 0)
+        {
+            if (line.size() != 64)
+            {
+                error = where.str() + "map rows must be 64 characters";
+                return false;
+            }
+
+            int y = mapRow--;
+            rows[y] = 0;
+
+            for (int x = 0; x != 64; x++)
+            {
+                Placement p;
+                p.x = x;
+                p.y = y;
+
+                switch (line[x])
+                {
+                case '#':
+                    rows[y] |= 1ULL << x;
+                    break;
+                case '.':
+                    break;
+                case 'B':
+                    boulders.push_back(p);
+                    break;
+                case 'G':
+                    rows[y] |= 1ULL << x;
+                    gold.push_back(p);
+                    break;
+                case 'L':
+                    rows[y] |= 1ULL << x;
+                    barrels.push_back(p);
+                    break;
+                default:
+                    error = where.str() + "unknown map character '" + line[x] + "'";
+                    return false;
+                }
+            }
+
+            continue;
+        }
+
+        string::size_type hash = line.find('#');
+        if (hash != string::npos)
+            line.erase(hash);
+
+        istringstream words(line);
+        string key;
+
+        if (!(words >> key))
+            continue;
+
+        if (key == "map")
+        {
+            mapRow = ICE_HEIGHT - 1;
+            continue;
+        }
+
+        long long a = 0;
+        long long b = 0;
+
+        if (!(words >> a) || ((key == "boulder" || key == "gold" || key == "barrel") && !(words >> b)))
+        {
+            error = where.str() + "missing value for " + key;
+            return false;
+        }
+
+        Placement p;
+        p.x = (int)a;
+        p.y = (int)b;
+
+        if (key == "seed")
+            d.seed = (unsigned long long)a;
+        else if (key == "protesters")
+            d.maxProtesters = (int)a;
+        else if (key == "rate")
+            d.ticksBetweenProtesters = (int)a;
+        else if (key == "goodies")
+            d.goodieChance = (int)a;
+        else if (key == "hardcore")
+            d.hardcoreChance = (int)a;
+        else if (key == "boulder")
+            boulders.push_back(p);
+        else if (key == "gold")
+            gold.push_back(p);
+        else if (key == "barrel")
+            barrels.push_back(p);
+        else
+        {
+            error = where.str() + "unknown keyword " + key;
+            return false;
+        }
+    }
+
+    if (mapRow >= 0)
+    {
+        error = "map must have 60 rows";
+        return false;
+    }
+
+    if (boulders.size() > 0xFFFF || gold.size() > 0xFFFF || barrels.size() > 0xFFFF)
+    {
+        error = "too many objects";
+        return false;
+    }
+
+    for (size_t i = 0; i != boulders.size(); i++)
+        if (inField(boulders[i]))
+            for (int y = boulders[i].y; y != boulders[i].y + 4; y++)
+                rows[y] &= ~(0xFULL << boulders[i].x);
+
+    // run the result through the loader's own checks before writing it
+    vector<unsigned char> image;
+    makeImage(d, image);
+
+    if (!validate(&image[0], image.size(), error))
+        return false;
+
+    out.write(reinterpret_cast<const char*>(&image[0]), image.size());
+    if (!out)
+    {
+        error = "write failed";
+        return false;
+    }
+
+    return true;
+}
+
+void LevelFile::makeImage(const LevelData& level, vector<unsigned char>& image)
+{
+    size_t nPlacements = level.boulders.size() + level.gold.size() + level.barrels.size();
+
+    LevelFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LEVEL_MAGIC, sizeof(LEVEL_MAGIC));
+    h.version = VERSION;
+    h.fileSize = (uint32_t)(sizeof(h) + nPlacements * sizeof(Placement));
+    h.seed = level.seed;
+    h.nBoulders = (uint16_t)level.boulders.size();
+    h.nGold = (uint16_t)level.gold.size();
+    h.nBarrels = (uint16_t)level.barrels.size();
+    h.maxProtesters = level.maxProtesters;
+    h.ticksBetweenProtesters = level.ticksBetweenProtesters;
+    h.goodieChance = level.goodieChance;
+    h.hardcoreChance = level.hardcoreChance;
+    memcpy(h.iceRows, level.iceRows, sizeof(h.iceRows));
+
+    image.resize(h.fileSize);
+    unsigned char* dst = &image[0];
+
+    memcpy(dst, &h, sizeof(h));
+    dst += sizeof(h);
+
+    const vector<Placement>* kinds[3] = { &level.boulders, &level.gold, &level.barrels };
+    for (int k = 0; k != 3; k++)
+        if (!kinds[k]->empty())
+        {
+            memcpy(dst, &(*kinds[k])[0], kinds[k]->size() * sizeof(Placement));
+            dst += kinds[k]->size() * sizeof(Placement);
+        }
+}
@@ -0,0 +1,75 @@
+#ifndef LEVELFILE_H_
+#define LEVELFILE_H_
+
+#include "LevelGenerator.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+
+// On-disk layout of a binary level (.lvl), little-endian. The header is
+// followed directly by the boulder, gold and barrel anchors, in that order,
+// each stored exactly like a Placement so they can be used in place.
+struct LevelFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t reserved;
+    uint64_t seed;
+
+    uint16_t nBoulders;
+    uint16_t nGold;
+    uint16_t nBarrels;
+    uint16_t reserved2;
+
+    // spawn rules; -1 keeps the normal level rule
+    int32_t maxProtesters;
+    int32_t ticksBetweenProtesters;
+    int32_t goodieChance;
+    int32_t hardcoreChance;
+
+    // bit x of row y is the ice at (x, y)
+    uint64_t iceRows[64];
+};
+
+// A fixed level loaded from a binary file. The file is mapped and checked
+// as it stands; nothing is parsed or allocated per element, and the same
+// map can be reloaded every time the level restarts.
+class LevelFile
+{
+public:
+    LevelFile();
+
+    // Maps path and checks it. On failure error says why.
+    bool open(const std::string& path, std::string& error);
+
+    // Copies the level into out, reusing out's storage.
+    void getLevel(int level, LevelData& out) const;
+
+    // Checks a whole level image without copying it.
+    static bool validate(const unsigned char* data, size_t size, std::string& error);
+
+    // Copies a validated image into out, reusing out's storage.
+    static void copyLevel(const unsigned char* data, int level, LevelData& out);
+
+    // Lays level out as a file image.
+    static void makeImage(const LevelData& level, std::vector<unsigned char>& image);
+
+    // Builds a binary level from a hand-authored text map (see
+    // LevelFile.cpp for the format).
+    static bool convertText(std::istream& in, std::ostream& out, std::string& error);
+
+    static const uint32_t VERSION = 1;
+
+private:
+    MappedFile m_file;
+    bool m_isOpen;
+
+    LevelFile(const LevelFile&);
+    LevelFile& operator=(const LevelFile&);
+};
+
+#endif // LEVELFILE_H_
@@ -0,0 +1,295 @@
+#include "LevelGenerator.h"
+#include "DistanceKernel.h"
+#include "IceManager.h"
+#include "StressConfig.h"
+#include <algorithm>
+#include <chrono>
+using namespace std;
+
+// Anchors an object may use: clear of the mine shaft, with the whole sprite
+// below the surface.
+const int MAX_ANCHOR_X = 60;
+const int MAX_ANCHOR_Y = 56;
+const int SHAFT_MIN_X = 27;
+const int SHAFT_MAX_X = 33;
+const int MIN_BOULDER_Y = 20;
+const int MIN_SEPARATION = 6;
+
+// Up to this many accepted points, checking each is cheaper than the 5x5
+// buckets around a candidate.
+const size_t MAX_LINEAR_CHECK = 64;
+
+// Misses in a row before place() stops drawing with replacement.
+const int MAX_QUICK_MISSES = 8;
+
+LevelGenerator::LevelGenerator()
+{
+    for (int i = 0; i != BUCKETS_X; i++)
+        for (int j = 0; j != BUCKETS_Y; j++)
+            m_buckets[i][j] = -1;
+}
+
+void LevelGenerator::listAnchors(int minY, vector<int>& out)
+{
+    out.clear();
+
+    for (int x = 0; x <= MAX_ANCHOR_X; x++)
+    {
+        if (x >= SHAFT_MIN_X && x <= SHAFT_MAX_X)
+            continue;
+
+        for (int y = minY; y <= MAX_ANCHOR_Y; y++)
+            out.push_back(x * 64 + y);
+    }
+}
+
+int LevelGenerator::getNumBoulders(int level)
+{
+    return min(level / 2 + 2, 9);
+}
+
+int LevelGenerator::getNumGold(int level)
+{
+    return max(5 - level / 2, 2);
+}
+
+int LevelGenerator::getNumBarrels(int level)
+{
+    return min(2 + level, 21);
+}
+
+void LevelGenerator::generate(Random& rng, int nBoulders, int nGold, int nBarrels)
+{
+    // listed on first use, since every world owns generators it may never
+    // run (clones in particular)
+    if (m_candidates.empty())
+    {
+        listAnchors(MIN_BOULDER_Y, m_boulderCandidates);
+        listAnchors(0, m_candidates);
+    }
+
+    m_boulders.clear();
+    m_gold.clear();
+    m_barrels.clear();
+
+    // only the buckets the last layout filled need emptying
+    for (size_t k = 0; k != m_accepted.size(); k++)
+        m_buckets[m_accepted[k] / 64 / BUCKET][m_accepted[k] % 64 / BUCKET] = -1;
+
+    m_accepted.clear();
+
+    place(rng, m_boulderCandidates, nBoulders, m_boulders);
+    place(rng, m_candidates, nGold, m_gold);
+    place(rng, m_candidates, nBarrels, m_barrels);
+
+    // put the lists back in their original order, newest swap first, so the
+    // next layout doesn't depend on this one
+    for (size_t k = m_swaps.size(); k-- != 0;)
+        swap((*m_swaps[k].candidates)[m_swaps[k].i], (*m_swaps[k].candidates)[m_swaps[k].j]);
+
+    m_swaps.clear();
+}
+
+void LevelGenerator::buildLevel(int level, unsigned long long seed, LevelData& out)
+{
+    StressConfig& stress = StressConfig::getInstance();
+    Random rng(seed);
+
+    generate(rng, stress.getNumBoulders(getNumBoulders(level)), stress.getNumGold(getNumGold(level)),
+        stress.getNumBarrels(getNumBarrels(level)));
+
+    out.level = level;
+    out.seed = seed;
+    out.boulders = m_boulders;
+    out.gold = m_gold;
+    out.barrels = m_barrels;
+    out.maxProtesters = -1;
+    out.ticksBetweenProtesters = -1;
+    out.goodieChance = -1;
+    out.hardcoreChance = -1;
+
+    IceManager::getInitialRows(out.iceRows);
+
+    for (size_t i = 0; i != m_boulders.size(); i++)
+        for (int y = m_boulders[i].y; y != m_boulders[i].y + 4; y++)
+            out.iceRows[y] &= ~(0xFULL << m_boulders[i].x);
+
+    out.nextSeed = rng.next();
+    out.rngState = rng.next();
+}
+
+// Draws candidates with replacement while they mostly land, which is all a
+// normal level needs, then without replacement until count are accepted or
+// none are left.
+void LevelGenerator::place(Random& rng, vector<int>& candidates, int count, vector<Placement>& out)
+{
+    for (int misses = 0; (int)out.size() < count && misses != MAX_QUICK_MISSES;)
+    {
+        int anchor = candidates[rng.nextIndex(candidates.size())];
+
+        Placement p;
+        p.x = anchor / 64;
+        p.y = anchor % 64;
+
+        if (isFarEnough(p.x, p.y))
+        {
+            accept(p.x, p.y);
+            out.push_back(p);
+            misses = 0;
+        }
+        else
+            misses++;
+    }
+
+    int remaining = candidates.size();
+
+    while ((int)out.size() < count && remaining > 0)
+    {
+        // partial Fisher-Yates: move each drawn anchor past the end
+        int i = rng.nextIndex(remaining);
+        int anchor = candidates[i];
+        candidates[i] = candidates[--remaining];
+        candidates[remaining] = anchor;
+
+        Swap s = { &candidates, i, remaining };
+        m_swaps.push_back(s);
+
+        Placement p;
+        p.x = anchor / 64;
+        p.y = anchor % 64;
+
+        if (isFarEnough(p.x, p.y))
+        {
+            accept(p.x, p.y);
+            out.push_back(p);
+        }
+    }
+}
+
+static bool isFarFromAll(const vector<Placement>& placed, int x, int y)
+{
+    for (size_t k = 0; k != placed.size(); k++)
+        if (doubledDistSquared(x, y, placed[k].x, placed[k].y) <= toDoubledRadiusSquared(MIN_SEPARATION))
+            return false;
+
+    return true;
+}
+
+bool LevelGenerator::isFarEnough(int x, int y) const
+{
+    if (m_accepted.size() <= MAX_LINEAR_CHECK)
+        return isFarFromAll(m_boulders, x, y) && isFarFromAll(m_gold, x, y) && isFarFromAll(m_barrels, x, y);
+
+    int bx = x / BUCKET;
+    int by = y / BUCKET;
+
+    for (int i = max(bx - 2, 0); i <= min(bx + 2, BUCKETS_X - 1); i++)
+        for (int j = max(by - 2, 0); j <= min(by + 2, BUCKETS_Y - 1); j++)
+        {
+            int other = m_buckets[i][j];
+
+            if (other >= 0 && doubledDistSquared(x, y, other / 64, other % 64) <= toDoubledRadiusSquared(MIN_SEPARATION))
+                return false;
+        }
+
+    return true;
+}
+
+void LevelGenerator::accept(int x, int y)
+{
+    m_buckets[x / BUCKET][y / BUCKET] = x * 64 + y;
+    m_accepted.push_back(x * 64 + y);
+}
+
+// What StudentWorld::init() used to do: random spots checked against every
+// object so far, up to 1000 tries each.
+static int placeByRejection(Random& rng, int minY, int count, vector<Placement>& placed)
+{
+    int n = 0;
+
+    for (int k = 0; k != count; k++)
+    {
+        for (int tries = 0; tries != 1000; tries++)
+        {
+            Placement p;
+            p.x = rng.nextInt(MAX_ANCHOR_X + 1);
+            p.y = minY + rng.nextInt(MAX_ANCHOR_Y + 1 - minY);
+
+            if (p.x >= SHAFT_MIN_X && p.x <= SHAFT_MAX_X)
+                continue;
+
+            bool ok = true;
+            for (size_t i = 0; i != placed.size() && ok; i++)
+                ok = doubledDistSquared(p.x, p.y, placed[i].x, placed[i].y) > toDoubledRadiusSquared(MIN_SEPARATION);
+
+            if (ok)
+            {
+                placed.push_back(p);
+                n++;
+                break;
+            }
+        }
+    }
+
+    return n;
+}
+
+void LevelGenerator::benchmark(ostream& out, int lastLevel, int runs)
+{
+    typedef chrono::steady_clock Clock;
+
+    LevelGenerator generator;
+    Random rng(12345);
+    vector<Placement> placed;
+
+    out << "level,objects,sampler_us,rejection_us,sampler_placed,rejection_placed" << endl;
+    out.setf(ios::fixed);
+    out.precision(2);
+
+    // the normal levels, then stress-sized layouts packed close to capacity
+    for (int row = 0; row <= lastLevel + 3; row++)
+    {
+        int level = row;
+        int nB = getNumBoulders(level);
+        int nG = getNumGold(level);
+        int nL = getNumBarrels(level);
+
+        if (row > lastLevel)
+        {
+            level = -1;
+            nB = 9;
+            nG = 10;
+            nL = 20 * (row - lastLevel);
+        }
+
+        long placedBySampler = 0;
+        long placedByRejection = 0;
+
+        Clock::time_point start = Clock::now();
+        for (int r = 0; r != runs; r++)
+        {
+            generator.generate(rng, nB, nG, nL);
+            placedBySampler += generator.getBoulders().size() + generator.getGold().size() + generator.getBarrels().size();
+        }
+        chrono::duration<double, micro> samplerTime = Clock::now() - start;
+
+        start = Clock::now();
+        for (int r = 0; r != runs; r++)
+        {
+            placed.clear();
+            placedByRejection += placeByRejection(rng, MIN_BOULDER_Y, nB, placed);
+            placedByRejection += placeByRejection(rng, 0, nG, placed);
+            placedByRejection += placeByRejection(rng, 0, nL, placed);
+        }
+        chrono::duration<double, micro> rejectionTime = Clock::now() - start;
+
+        if (level >= 0)
+            out << level;
+        else
+            out << "stress";
+
+        out << "," << nB + nG + nL << ","
+            << samplerTime.count() / runs << "," << rejectionTime.count() / runs << ","
+            << (double)placedBySampler / runs << "," << (double)placedByRejection / runs << endl;
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef LEVELGENERATOR_H_
+#define LEVELGENERATOR_H_
+
+#include "Random.h"
+#include <vector>
+#include <ostream>
+
+struct Placement
+{
+    int x;
+    int y;
+};
+
+// Everything StudentWorld::init() needs to set a level up, as plain data, so
+// it can be prepared away from the game thread.
+struct LevelData
+{
+    int level;
+    unsigned long long seed;
+
+    // ice left once the boulders' spots are dug out (bit x of row y)
+    unsigned long long iceRows[64];
+
+    std::vector<Placement> boulders;
+    std::vector<Placement> gold;
+    std::vector<Placement> barrels;
+
+    // spawn rules for the level; -1 keeps the normal rule
+    int maxProtesters;
+    int ticksBetweenProtesters;
+    int goodieChance;
+    int hardcoreChance;
+
+    // the world's generator state for playing the level, and the seed the
+    // next level will be built from
+    unsigned long long rngState;
+    unsigned long long nextSeed;
+};
+
+// Lays out a level's boulders, gold and barrels so that no two are within 6
+// of each other and none sit in the mine shaft.
+//
+// Each kind draws candidate anchors from the cells it may use and checks them
+// against a bucket grid of accepted points. Draws are with replacement while
+// they mostly land, as on any normal level; once they keep missing, the
+// rest are drawn without replacement, so one pass over the candidates either
+// fills the quota or proves there is no more room, rather than retrying
+// random spots indefinitely.
+class LevelGenerator
+{
+public:
+    LevelGenerator();
+
+    void generate(Random& rng, int nBoulders, int nGold, int nBarrels);
+
+    // Lays out the whole level from its seed, honouring any stress overrides.
+    void buildLevel(int level, unsigned long long seed, LevelData& out);
+
+    const std::vector<Placement>& getBoulders() const
+    {
+        return m_boulders;
+    }
+
+    const std::vector<Placement>& getGold() const
+    {
+        return m_gold;
+    }
+
+    const std::vector<Placement>& getBarrels() const
+    {
+        return m_barrels;
+    }
+
+    // The normal per-level quotas.
+    static int getNumBoulders(int level);
+    static int getNumGold(int level);
+    static int getNumBarrels(int level);
+
+    // Times generate() for each level up to lastLevel, plus a few densely
+    // packed stress layouts, against the old rejection sampler and writes a
+    // CSV of the results.
+    static void benchmark(std::ostream& out, int lastLevel, int runs);
+
+private:
+    // Any two anchors in a 4x4 bucket are closer than 6, so each bucket
+    // holds at most one accepted point and only buckets within two of a
+    // candidate's need checking.
+    static const int BUCKET = 4;
+    static const int BUCKETS_X = (60 + BUCKET) / BUCKET;
+    static const int BUCKETS_Y = (56 + BUCKET) / BUCKET;
+
+    static void listAnchors(int minY, std::vector<int>& out);
+    void place(Random& rng, std::vector<int>& candidates, int count, std::vector<Placement>& out);
+    bool isFarEnough(int x, int y) const;
+    void accept(int x, int y);
+
+    std::vector<Placement> m_boulders;
+    std::vector<Placement> m_gold;
+    std::vector<Placement> m_barrels;
+
+    // A draw's exchange of two entries in one of the candidate lists.
+    struct Swap
+    {
+        std::vector<int>* candidates;
+        int i;
+        int j;
+    };
+
+    // Anchors each kind may use, built on first use. generate() shuffles
+    // them in place and then undoes its swaps, so every layout starts from
+    // the original order and a seed always gives the same layout whatever
+    // was generated before.
+    std::vector<int> m_boulderCandidates;
+    std::vector<int> m_candidates;
+    std::vector<Swap> m_swaps;
+
+    // this layout's points so far, also kept in the buckets, so only the
+    // buckets used need emptying for the next
+    std::vector<int> m_accepted;
+    int m_buckets[BUCKETS_X][BUCKETS_Y];
+};
+
+#endif // LEVELGENERATOR_H_
@@ -0,0 +1,153 @@
+#include "LevelPack.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <cstring>
+using namespace std;
+
+static_assert(sizeof(LevelPackHeader) == 24, "level pack header layout changed");
+static_assert(sizeof(LevelPackEntry) == 16, "level pack index layout changed");
+
+const char PACK_MAGIC[4] = { 'I', 'C', 'E', 'P' };
+
+LevelPack::LevelPack()
+    : m_entries(nullptr), m_count(0)
+{
+}
+
+bool LevelPack::open(const string& path, string& error)
+{
+    m_entries = nullptr;
+    m_count = 0;
+
+    if (!m_file.open(path))
+    {
+        error = "can't open " + path;
+        return false;
+    }
+
+    const unsigned char* data = m_file.getData();
+    size_t size = m_file.getSize();
+    const LevelPackHeader& h = *reinterpret_cast<const LevelPackHeader*>(data);
+
+    if (size < sizeof(LevelPackHeader))
+        error = "file is too short";
+    else if (memcmp(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0)
+        error = "not a level pack";
+    else if (h.version != VERSION)
+        error = "unsupported level pack version";
+    else if (h.fileSize != size || h.count == 0 || h.count > (size - sizeof(LevelPackHeader)) / sizeof(LevelPackEntry))
+        error = "file size doesn't match its header";
+    else
+        error.clear();
+
+    if (!error.empty())
+    {
+        m_file.close();
+        return false;
+    }
+
+    const LevelPackEntry* entries = reinterpret_cast<const LevelPackEntry*>(data + sizeof(LevelPackHeader));
+
+    for (uint32_t i = 0; i != h.count; i++)
+        if (entries[i].offset % 8 != 0 || entries[i].offset > size || entries[i].size > size - entries[i].offset)
+        {
+            error = "bad level index";
+            m_file.close();
+            return false;
+        }
+
+    m_entries = entries;
+    m_count = h.count;
+    return true;
+}
+
+bool LevelPack::getLevel(int n, LevelData& out, string& error) const
+{
+    if (n < 0 || n >= m_count)
+    {
+        error = "no such level in the pack";
+        return false;
+    }
+
+    const unsigned char* image = m_file.getData() + m_entries[n].offset;
+
+    if (!LevelFile::validate(image, m_entries[n].size, error))
+        return false;
+
+    LevelFile::copyLevel(image, n, out);
+    return true;
+}
+
+// Levels are independent, so each worker takes the next unbuilt one with a
+// generator of its own.
+static void buildImages(unsigned long long firstSeed, int count, atomic<int>& next, vector<vector<unsigned char> >& images)
+{
+    LevelGenerator generator;
+    LevelData level;
+
+    for (int n = next++; n < count; n = next++)
+    {
+        generator.buildLevel(n, firstSeed + n, level);
+        LevelFile::makeImage(level, images[n]);
+    }
+}
+
+bool LevelPack::build(const string& path, unsigned long long firstSeed, int count, int nThreads, string& error)
+{
+    if (count < 1)
+    {
+        error = "a pack needs at least one level";
+        return false;
+    }
+
+    if (nThreads < 1)
+        nThreads = 1;
+
+    vector<vector<unsigned char> > images(count);
+    atomic<int> next(0);
+
+    vector<thread> workers;
+    for (int t = 0; t != nThreads; t++)
+        workers.push_back(thread(buildImages, firstSeed, count, ref(next), ref(images)));
+
+    for (size_t t = 0; t != workers.size(); t++)
+        workers[t].join();
+
+    LevelPackHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    h.version = VERSION;
+    h.count = count;
+
+    // images are whole multiples of 8 bytes, so laying them out in order
+    // keeps each one aligned
+    vector<LevelPackEntry> entries(count);
+    uint64_t offset = sizeof(h) + count * sizeof(LevelPackEntry);
+
+    for (int n = 0; n != count; n++)
+    {
+        entries[n].offset = offset;
+        entries[n].size = (uint32_t)images[n].size();
+        entries[n].reserved = 0;
+        offset += images[n].size();
+    }
+
+    h.fileSize = offset;
+
+    ofstream out(path.c_str(), ios::binary);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(reinterpret_cast<const char*>(&entries[0]), count * sizeof(LevelPackEntry));
+
+    for (int n = 0; n != count; n++)
+        out.write(reinterpret_cast<const char*>(&images[n][0]), images[n].size());
+
+    if (!out)
+    {
+        error = "can't write " + path;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef LEVELPACK_H_
+#define LEVELPACK_H_
+
+#include "LevelFile.h"
+#include <cstdint>
+#include <string>
+
+// On-disk layout of a level pack (.lvp), little-endian: this header, then
+// one LevelPackEntry per level, then the levels' LevelFile images back to
+// back, each starting on an 8-byte boundary.
+struct LevelPackHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t fileSize;
+};
+
+struct LevelPackEntry
+{
+    uint64_t offset;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+// Many pre-generated levels in one mapped file. Entry n is level n, so
+// setting a level up is an index lookup and a copy; nothing is generated.
+class LevelPack
+{
+public:
+    LevelPack();
+
+    // Maps path and checks its index. On failure error says why.
+    bool open(const std::string& path, std::string& error);
+
+    bool isOpen() const
+    {
+        return m_count > 0;
+    }
+
+    int getCount() const
+    {
+        return m_count;
+    }
+
+    // Copies level n into out. The image is checked as it is used, so a
+    // corrupt level only fails when it's reached.
+    bool getLevel(int n, LevelData& out, std::string& error) const;
+
+    // Generates levels 0 to count - 1 from seeds firstSeed, firstSeed + 1,
+    // ... on nThreads threads and writes them as a pack.
+    static bool build(const std::string& path, unsigned long long firstSeed, int count, int nThreads, std::string& error);
+
+    static const uint32_t VERSION = 1;
+
+private:
+    MappedFile m_file;
+    const LevelPackEntry* m_entries;
+    int m_count;
+
+    LevelPack(const LevelPack&);
+    LevelPack& operator=(const LevelPack&);
+};
+
+#endif // LEVELPACK_H_
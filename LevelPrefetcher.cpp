@@ -0,0 +1,40 @@
+#include "LevelPrefetcher.h"
+using namespace std;
+
+LevelPrefetcher::LevelPrefetcher()
+    : m_ready(false)
+{
+}
+
+LevelPrefetcher::~LevelPrefetcher()
+{
+    wait();
+}
+
+void LevelPrefetcher::wait()
+{
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+void LevelPrefetcher::request(int level, unsigned long long seed)
+{
+    wait();
+
+    // the worker is the only one touching m_generator and m_data until the
+    // next wait()
+    m_ready = true;
+    m_worker = thread(&LevelGenerator::buildLevel, &m_generator, level, seed, ref(m_data));
+}
+
+bool LevelPrefetcher::take(int level, unsigned long long seed, LevelData& out)
+{
+    wait();
+
+    if (!m_ready || m_data.level != level || m_data.seed != seed)
+        return false;
+
+    m_ready = false;
+    swap(out, m_data);
+    return true;
+}
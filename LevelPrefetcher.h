@@ -0,0 +1,36 @@
+#ifndef LEVELPREFETCHER_H_
+#define LEVELPREFETCHER_H_
+
+#include "LevelGenerator.h"
+#include <thread>
+
+// Builds the next level's LevelData on a worker thread while the current one
+// is played, so init() only has to instantiate it. Only plain data is made
+// off the game thread; every GraphObject is still created by init().
+class LevelPrefetcher
+{
+public:
+    LevelPrefetcher();
+    ~LevelPrefetcher();
+
+    // Starts building the level in the background, replacing any earlier
+    // request.
+    void request(int level, unsigned long long seed);
+
+    // Hands over the prepared level if it is the one asked for, waiting for
+    // the worker to finish if need be. False means build it directly.
+    bool take(int level, unsigned long long seed, LevelData& out);
+
+private:
+    void wait();
+
+    std::thread m_worker;
+    LevelGenerator m_generator;
+    LevelData m_data;
+    bool m_ready;
+
+    LevelPrefetcher(const LevelPrefetcher&);
+    LevelPrefetcher& operator=(const LevelPrefetcher&);
+};
+
+#endif // LEVELPREFETCHER_H_
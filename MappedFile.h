@@ -0,0 +1,43 @@
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <string>
+#include <cstddef>
+
+// A whole file mapped read-only into memory, so fixed-layout data can be used
+// in place instead of being read and parsed.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Maps path, replacing anything already mapped. False if the file can't
+    // be opened or is empty.
+    bool open(const std::string& path);
+    void close();
+
+    const unsigned char* getData() const
+    {
+        return m_data;
+    }
+
+    size_t getSize() const
+    {
+        return m_size;
+    }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+#endif // MAPPEDFILE_H_
@@ -0,0 +1,121 @@
+#include "OccupancyGrid.h"
+#include <cstring>
+using namespace std;
+
+OccupancyGrid::OccupancyGrid()
+{
+    clear();
+}
+
+void OccupancyGrid::clear()
+{
+    memset(m_rows, 0, sizeof(m_rows));
+    memset(m_counts, 0, sizeof(m_counts));
+}
+
+// Bits x..x+w-1, clipped to the field.
+unsigned long long OccupancyGrid::spanMask(int x, int w)
+{
+    int lo = x < 0 ? 0 : x;
+    int hi = x + w > 64 ? 64 : x + w;
+
+    if (lo >= hi)
+        return 0;
+
+    unsigned long long bits = hi - lo == 64 ? ~0ULL : (1ULL << (hi - lo)) - 1;
+    return bits << lo;
+}
+
+void OccupancyGrid::update(Occupant type, int x, int y, int delta)
+{
+    if (type == OCC_NONE)
+        return;
+
+    for (int j = y; j != y + 4; j++)
+    {
+        if (j < 0 || j > 63)
+            continue;
+
+        for (int i = x; i != x + 4; i++)
+        {
+            if (i < 0 || i > 63)
+                continue;
+
+            unsigned short& count = m_counts[type][j][i];
+
+            if (delta < 0 && count == 0)
+                continue;
+
+            count += delta;
+
+            if (count == 0)
+                m_rows[type][j] &= ~(1ULL << i);
+            else
+                m_rows[type][j] |= 1ULL << i;
+        }
+    }
+}
+
+void OccupancyGrid::add(Occupant type, int x, int y)
+{
+    update(type, x, y, 1);
+}
+
+void OccupancyGrid::remove(Occupant type, int x, int y)
+{
+    update(type, x, y, -1);
+}
+
+bool OccupancyGrid::anyInBox(Occupant type, int x, int y, int w, int h) const
+{
+    unsigned long long mask = spanMask(x, w);
+
+    for (int j = y; j != y + h; j++)
+        if (getRow(type, j) & mask)
+            return true;
+
+    return false;
+}
+
+bool OccupancyGrid::anythingInBox(int x, int y, int w, int h) const
+{
+    for (int type = 0; type != NUM_OCCUPANTS; type++)
+        if (anyInBox(Occupant(type), x, y, w, h))
+            return true;
+
+    return false;
+}
+
+int OccupancyGrid::firstAlongEdge(Occupant type, int x, int y, GraphObject::Direction dir) const
+{
+    switch (dir)
+    {
+    case GraphObject::up:
+    case GraphObject::down:
+    {
+        unsigned long long row = getRow(type, dir == GraphObject::up ? y + 3 : y) & spanMask(x, 4);
+
+        for (int i = 0; row != 0 && i != 4; i++)
+            if (x + i >= 0 && x + i <= 63 && ((row >> (x + i)) & 1))
+                return i;
+
+        return -1;
+    }
+    case GraphObject::left:
+    case GraphObject::right:
+    {
+        int column = dir == GraphObject::right ? x + 3 : x;
+
+        if (column < 0 || column > 63)
+            return -1;
+
+        for (int i = 0; i != 4; i++)
+            if ((getRow(type, y + i) >> column) & 1)
+                return i;
+
+        return -1;
+    }
+    default:
+        return -1;
+    }
+}
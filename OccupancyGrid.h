@@ -0,0 +1,55 @@
+#ifndef OCCUPANCYGRID_H_
+#define OCCUPANCYGRID_H_
+
+#include "GraphObject.h"
+
+// What kind of thing an actor is, as far as the occupancy grid is concerned.
+enum Occupant
+{
+    OCC_NONE = -1,
+    OCC_BOULDER,
+    OCC_BARREL,
+    OCC_GOLD,
+    OCC_PROTESTER,
+    OCC_WATER,
+    OCC_OTHER,
+    NUM_OCCUPANTS
+};
+
+// Which cells are covered by which kinds of actor, as one 64x64 bitboard per
+// kind laid out like IceManager's rows (bit x of row y), so box and edge
+// tests are a few mask operations and can be or'ed with the ice rows.
+// Actors of a kind may overlap (protesters do all the time), so each cell
+// also keeps a count and its bit only clears when the last one leaves.
+class OccupancyGrid
+{
+public:
+    OccupancyGrid();
+
+    void clear();
+
+    // Covers or uncovers the 4x4 box anchored at (x, y).
+    void add(Occupant type, int x, int y);
+    void remove(Occupant type, int x, int y);
+
+    bool anyInBox(Occupant type, int x, int y, int w = 4, int h = 4) const;
+    bool anythingInBox(int x, int y, int w = 4, int h = 4) const;
+
+    // The offset (0-3) of the first cell holding the type along the side of
+    // the 4x4 box at (x, y) that faces dir, or -1 if there is none.
+    int firstAlongEdge(Occupant type, int x, int y, GraphObject::Direction dir) const;
+
+    unsigned long long getRow(Occupant type, int y) const
+    {
+        return y < 0 || y > 63 ? 0 : m_rows[type][y];
+    }
+
+private:
+    static unsigned long long spanMask(int x, int w);
+    void update(Occupant type, int x, int y, int delta);
+
+    unsigned long long m_rows[NUM_OCCUPANTS][64];
+    unsigned short m_counts[NUM_OCCUPANTS][64][64];
+};
+
+#endif // OCCUPANCYGRID_H_
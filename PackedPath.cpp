@@ -0,0 +1,125 @@
+#include "PackedPath.h"
+#include <algorithm>
+using namespace std;
+
+// 2-bit codes for each step, in the same order as the NAV_ direction bits.
+static const GraphObject::Direction STEP_DIRS[4] = { GraphObject::up, GraphObject::down, GraphObject::left, GraphObject::right };
+
+static unsigned long long toStepCode(GraphObject::Direction dir)
+{
+    switch (dir)
+    {
+    case GraphObject::down:
+        return 1;
+    case GraphObject::left:
+        return 2;
+    case GraphObject::right:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+PackedPath::PackedPath()
+    : m_length(0), m_cursor(0)
+{
+    for (int i = 0; i != INLINE_WORDS; i++)
+        m_inline[i] = 0;
+}
+
+unsigned long long& PackedPath::word(int i)
+{
+    return i < INLINE_WORDS ? m_inline[i] : m_spill[i - INLINE_WORDS];
+}
+
+unsigned long long PackedPath::word(int i) const
+{
+    return i < INLINE_WORDS ? m_inline[i] : m_spill[i - INLINE_WORDS];
+}
+
+void PackedPath::clear()
+{
+    // keep the spill capacity around for the next route
+    m_spill.clear();
+    m_length = 0;
+    m_cursor = 0;
+}
+
+void PackedPath::push(GraphObject::Direction dir)
+{
+    int w = m_length / STEPS_PER_WORD;
+    int shift = (m_length % STEPS_PER_WORD) * 2;
+
+    if (shift == 0)
+    {
+        if (w < INLINE_WORDS)
+            m_inline[w] = 0;
+        else
+            m_spill.push_back(0);
+    }
+
+    word(w) |= toStepCode(dir) << shift;
+    m_length++;
+}
+
+GraphObject::Direction PackedPath::front() const
+{
+    if (empty())
+        return GraphObject::none;
+
+    int shift = (m_cursor % STEPS_PER_WORD) * 2;
+
+    return STEP_DIRS[(word(m_cursor / STEPS_PER_WORD) >> shift) & 3];
+}
+
+void PackedPath::advance()
+{
+    if (!empty())
+        m_cursor++;
+}
+
+int PackedPath::save(unsigned long long* out, int maxSteps) const
+{
+    int n = min(size(), maxSteps);
+
+    for (int i = 0; i < n; i += STEPS_PER_WORD)
+        out[i / STEPS_PER_WORD] = 0;
+
+    for (int i = 0; i != n; i++)
+    {
+        int from = m_cursor + i;
+        unsigned long long code = (word(from / STEPS_PER_WORD) >> (from % STEPS_PER_WORD) * 2) & 3;
+
+        out[i / STEPS_PER_WORD] |= code << (i % STEPS_PER_WORD) * 2;
+    }
+
+    return n;
+}
+
+void PackedPath::load(const unsigned long long* steps, int n)
+{
+    clear();
+
+    for (int i = 0; i != n; i++)
+        push(STEP_DIRS[(steps[i / STEPS_PER_WORD] >> (i % STEPS_PER_WORD) * 2) & 3]);
+}
+
+void PackedPath::swap(PackedPath& other)
+{
+    for (int i = 0; i != INLINE_WORDS; i++)
+    {
+        unsigned long long w = m_inline[i];
+        m_inline[i] = other.m_inline[i];
+        other.m_inline[i] = w;
+    }
+
+    m_spill.swap(other.m_spill);
+
+    int n = m_length;
+    m_length = other.m_length;
+    other.m_length = n;
+
+    n = m_cursor;
+    m_cursor = other.m_cursor;
+    other.m_cursor = n;
+}
@@ -0,0 +1,58 @@
+#ifndef PACKEDPATH_H_
+#define PACKEDPATH_H_
+
+#include "GraphObject.h"
+#include <vector>
+
+// A route of single-cell moves stored at 2 bits per step with a read cursor.
+// Up to INLINE_STEPS moves live inside the object; longer routes spill into
+// a vector. Taking the next step is O(1) and never copies the rest of the
+// path.
+class PackedPath
+{
+public:
+    PackedPath();
+
+    void clear();
+    void push(GraphObject::Direction dir);
+
+    bool empty() const
+    {
+        return m_cursor >= m_length;
+    }
+
+    // Number of steps not yet taken.
+    int size() const
+    {
+        return m_length - m_cursor;
+    }
+
+    GraphObject::Direction front() const;
+    void advance();
+
+    // O(1) when both paths fit inline, otherwise swaps the spill buffers.
+    void swap(PackedPath& other);
+
+    // Copies up to maxSteps of the steps not yet taken into out, packed the
+    // same way, and returns how many were copied.
+    int save(unsigned long long* out, int maxSteps) const;
+
+    // Replaces the route with n steps packed as by save().
+    void load(const unsigned long long* steps, int n);
+
+    static const int INLINE_STEPS = 128;
+
+private:
+    static const int STEPS_PER_WORD = 32;
+    static const int INLINE_WORDS = INLINE_STEPS / STEPS_PER_WORD;
+
+    unsigned long long& word(int i);
+    unsigned long long word(int i) const;
+
+    unsigned long long m_inline[INLINE_WORDS];
+    std::vector<unsigned long long> m_spill;
+    int m_length;
+    int m_cursor;
+};
+
+#endif // PACKEDPATH_H_
@@ -0,0 +1,565 @@
+#include "PathFinder.h"
+#include "IceManager.h"
+#include "StudentWorld.h"
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+// Number of set bits in each 4-bit direction mask, with 0 mapped to 1 so it
+// can always be used as a divisor.
+static const int NUM_CHOICES[16] = { 1, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+// NTH_DIR[mask][k] is the k-th set direction of mask (bit 0 = up, 1 = down,
+// 2 = left, 3 = right); an empty mask yields none.
+static const GraphObject::Direction U = GraphObject::up;
+static const GraphObject::Direction D = GraphObject::down;
+static const GraphObject::Direction L = GraphObject::left;
+static const GraphObject::Direction R = GraphObject::right;
+static const GraphObject::Direction N = GraphObject::none;
+
+static const GraphObject::Direction NTH_DIR[16][4] = {
+    { N, N, N, N }, { U, N, N, N }, { D, N, N, N }, { U, D, N, N },
+    { L, N, N, N }, { U, L, N, N }, { D, L, N, N }, { U, D, L, N },
+    { R, N, N, N }, { U, R, N, N }, { D, R, N, N }, { U, D, R, N },
+    { L, R, N, N }, { U, L, R, N }, { D, L, R, N }, { U, D, L, R },
+};
+
+PathFinder::Grid::Grid()
+    : exitFieldDirty(true)
+{
+    for (int x = 0; x != 64; x++)
+        for (int y = 0; y != 64; y++)
+        {
+            nav[x][y] = 0;
+            exitDist[x][y] = UNREACHABLE;
+        }
+}
+
+PathFinder::PlayerField::PlayerField()
+    : nVisited(0)
+{
+    for (int x = 0; x != 64; x++)
+        for (int y = 0; y != 64; y++)
+            dist[x][y] = UNREACHABLE;
+}
+
+// One empty grid shared by every PathFinder not yet given a map, so making
+// one copies nothing.
+shared_ptr<PathFinder::Grid> PathFinder::emptyGrid()
+{
+    static shared_ptr<Grid> empty = make_shared<Grid>();
+    return empty;
+}
+
+PathFinder::PathFinder()
+    : m_world(nullptr), m_ice(nullptr), m_grid(emptyGrid()),
+    m_playerFieldDepth(0), m_playerFieldX(-1), m_playerFieldY(-1),
+    m_playerFieldBuiltDepth(0), m_gridVersion(0), m_playerFieldVersion(0)
+{
+}
+
+void PathFinder::init(StudentWorld* world, IceManager* ice)
+{
+    m_world = world;
+    m_ice = ice;
+    m_playerFieldDepth = 0;
+    m_playerFieldX = -1;
+    updateGrid();
+}
+
+void PathFinder::share(PathFinder& other, StudentWorld* world, IceManager* ice)
+{
+    // a shared grid has nothing left to build lazily, so nothing writes to
+    // it in place
+    if (other.m_grid->exitFieldDirty)
+        other.buildExitField();
+    other.m_grid->components.compress();
+
+    m_world = world;
+    m_ice = ice;
+    m_grid = other.m_grid;
+    m_gridVersion = other.m_gridVersion;
+    m_playerFieldDepth = 0;
+    m_playerFieldX = -1;
+}
+
+PathFinder::Grid& PathFinder::edit()
+{
+    if (m_grid.use_count() != 1)
+        m_grid = make_shared<Grid>(*m_grid);
+
+    return *m_grid;
+}
+
+bool PathFinder::computeOpen(int x, int y) const
+{
+    return x >= 0 && x <= 60 && y >= 0 && y <= 60 && m_ice->checkIce(x, y) && !m_world->boulderInBox(x, y);
+}
+
+void PathFinder::updateMask(Grid& g, int x, int y)
+{
+    unsigned char nav = g.nav[x][y] & NAV_OPEN;
+
+    if (isOpen(x, y + 1))
+        nav |= NAV_UP;
+    if (isOpen(x, y - 1))
+        nav |= NAV_DOWN;
+    if (isOpen(x - 1, y))
+        nav |= NAV_LEFT;
+    if (isOpen(x + 1, y))
+        nav |= NAV_RIGHT;
+
+    if ((nav & (NAV_UP | NAV_DOWN)) && (nav & (NAV_LEFT | NAV_RIGHT)))
+        nav |= NAV_INTERSECTION;
+
+    g.nav[x][y] = nav;
+}
+
+void PathFinder::updateGrid()
+{
+    Grid& g = edit();
+
+    for (int x = 0; x != 64; x++)
+        for (int y = 0; y != 64; y++)
+            g.nav[x][y] = computeOpen(x, y) ? NAV_OPEN : 0;
+
+    for (int x = 0; x <= 60; x++)
+        for (int y = 0; y <= 60; y++)
+        {
+            updateMask(g, x, y);
+            g.components.setOpen(x, y, isOpen(x, y));
+        }
+
+    g.components.invalidate();
+
+    for (int i = 0; i <= 60; i++)
+    {
+        rebuildRow(g, i);
+        rebuildColumn(g, i);
+    }
+
+    g.exitFieldDirty = true;
+    m_gridVersion++;
+}
+
+void PathFinder::updateGrid(int x, int y, int h)
+{
+    Grid& g = edit();
+    int top = y + h - 1;
+
+    // anchors whose 4x4 box overlaps the changed box, then their neighbours
+    for (int i = max(x - 3, 0); i <= min(x + 3, 60); i++)
+        for (int j = max(y - 3, 0); j <= min(top, 60); j++)
+        {
+            g.nav[i][j] = computeOpen(i, j) ? NAV_OPEN : 0;
+            g.components.setOpen(i, j, isOpen(i, j));
+        }
+
+    for (int i = max(x - 3, 0); i <= min(x + 3, 60); i++)
+        for (int j = max(y - 3, 0); j <= min(top, 60); j++)
+            g.components.mergeWithNeighbours(i, j);
+
+    for (int i = max(x - 4, 0); i <= min(x + 4, 60); i++)
+        for (int j = max(y - 4, 0); j <= min(top + 1, 60); j++)
+            updateMask(g, i, j);
+
+    for (int j = max(y - 3, 0); j <= min(top, 60); j++)
+        rebuildRow(g, j);
+
+    for (int i = max(x - 3, 0); i <= min(x + 3, 60); i++)
+        rebuildColumn(g, i);
+
+    g.exitFieldDirty = true;
+    m_gridVersion++;
+}
+
+void PathFinder::rebuildRow(Grid& g, int y)
+{
+    signed char blocked = -1;
+    for (int x = 0; x <= 60; x++)
+    {
+        if (!isOpen(x, y))
+            blocked = x;
+        g.blockedLeft[x][y] = blocked;
+    }
+
+    blocked = 61;
+    for (int x = 60; x >= 0; x--)
+    {
+        if (!isOpen(x, y))
+            blocked = x;
+        g.blockedRight[x][y] = blocked;
+    }
+}
+
+void PathFinder::rebuildColumn(Grid& g, int x)
+{
+    signed char blocked = -1;
+    for (int y = 0; y <= 60; y++)
+    {
+        if (!isOpen(x, y))
+            blocked = y;
+        g.blockedDown[x][y] = blocked;
+    }
+
+    blocked = 61;
+    for (int y = 60; y >= 0; y--)
+    {
+        if (!isOpen(x, y))
+            blocked = y;
+        g.blockedUp[x][y] = blocked;
+    }
+}
+
+bool PathFinder::isOpen(int x, int y) const
+{
+    if (x < 0 || x > 60 || y < 0 || y > 60)
+        return false;
+
+    return (m_grid->nav[x][y] & NAV_OPEN) != 0;
+}
+
+unsigned char PathFinder::getValidDirections(int x, int y) const
+{
+    if (x < 0 || x > 60 || y < 0 || y > 60)
+        return 0;
+
+    return m_grid->nav[x][y] & NAV_DIRS;
+}
+
+bool PathFinder::isIntersection(int x, int y) const
+{
+    if (x < 0 || x > 60 || y < 0 || y > 60)
+        return false;
+
+    return (m_grid->nav[x][y] & NAV_INTERSECTION) != 0;
+}
+
+unsigned char PathFinder::getValidPerpDirs(int x, int y, GraphObject::Direction dir) const
+{
+    unsigned char perpendicular = (dir == GraphObject::left || dir == GraphObject::right) ? (NAV_UP | NAV_DOWN) : (NAV_LEFT | NAV_RIGHT);
+
+    return getValidDirections(x, y) & perpendicular;
+}
+
+bool PathFinder::canMove(int x, int y, GraphObject::Direction dir) const
+{
+    return (getValidDirections(x, y) & toDirBit(dir)) != 0;
+}
+
+unsigned char PathFinder::toDirBit(GraphObject::Direction dir)
+{
+    switch (dir)
+    {
+    case GraphObject::up:
+        return NAV_UP;
+    case GraphObject::down:
+        return NAV_DOWN;
+    case GraphObject::left:
+        return NAV_LEFT;
+    case GraphObject::right:
+        return NAV_RIGHT;
+    default:
+        return 0;
+    }
+}
+
+GraphObject::Direction PathFinder::chooseRandomDirection(unsigned char dirs, Random& rng)
+{
+    dirs &= NAV_DIRS;
+    return NTH_DIR[dirs][rng.nextInt(NUM_CHOICES[dirs])];
+}
+
+void PathFinder::buildExitField()
+{
+    Grid& g = edit();
+
+    buildExitField(g.nav, g.exitDist);
+    g.exitFieldDirty = false;
+}
+
+void PathFinder::buildExitField(const unsigned char nav[64][64], int dist[64][64])
+{
+    int queue[61 * 61];
+
+    for (int x = 0; x != 64; x++)
+        for (int y = 0; y != 64; y++)
+            dist[x][y] = UNREACHABLE;
+
+    if (!(nav[60][60] & NAV_OPEN))
+        return;
+
+    int head = 0;
+    int tail = 0;
+
+    dist[60][60] = 0;
+    queue[tail++] = 60 * 64 + 60;
+
+    while (head != tail)
+    {
+        int x = queue[head] / 64;
+        int y = queue[head] % 64;
+        head++;
+
+        unsigned char dirs = nav[x][y];
+        int next = dist[x][y] + 1;
+
+        if ((dirs & NAV_UP) && dist[x][y + 1] == UNREACHABLE)
+        {
+            dist[x][y + 1] = next;
+            queue[tail++] = x * 64 + y + 1;
+        }
+        if ((dirs & NAV_DOWN) && dist[x][y - 1] == UNREACHABLE)
+        {
+            dist[x][y - 1] = next;
+            queue[tail++] = x * 64 + y - 1;
+        }
+        if ((dirs & NAV_LEFT) && dist[x - 1][y] == UNREACHABLE)
+        {
+            dist[x - 1][y] = next;
+            queue[tail++] = (x - 1) * 64 + y;
+        }
+        if ((dirs & NAV_RIGHT) && dist[x + 1][y] == UNREACHABLE)
+        {
+            dist[x + 1][y] = next;
+            queue[tail++] = (x + 1) * 64 + y;
+        }
+    }
+}
+
+bool PathFinder::isReachable(int x1, int y1, int x2, int y2)
+{
+    return m_grid->components.isConnected(x1, y1, x2, y2);
+}
+
+int PathFinder::getExitDistance(int x, int y)
+{
+    // no point searching from a pocket that isn't joined to the exit
+    if (!isReachable(x, y, 60, 60))
+        return UNREACHABLE;
+
+    if (m_grid->exitFieldDirty)
+        buildExitField();
+
+    return m_grid->exitDist[x][y];
+}
+
+void PathFinder::getPathToExitFrom(int x, int y, PackedPath& path)
+{
+    path.clear();
+
+    if (getExitDistance(x, y) == UNREACHABLE)
+        return;
+
+    walkExitField(m_grid->nav, m_grid->exitDist, x, y, path);
+}
+
+void PathFinder::walkExitField(const unsigned char nav[64][64], const int dist[64][64], int x, int y, PackedPath& path)
+{
+    path.clear();
+
+    if (x < 0 || x > 60 || y < 0 || y > 60 || dist[x][y] == UNREACHABLE)
+        return;
+
+    while (dist[x][y] != 0)
+    {
+        int d = dist[x][y] - 1;
+        unsigned char dirs = nav[x][y];
+
+        if ((dirs & NAV_UP) && dist[x][y + 1] == d)
+        {
+            path.push(GraphObject::up);
+            y++;
+        }
+        else if ((dirs & NAV_DOWN) && dist[x][y - 1] == d)
+        {
+            path.push(GraphObject::down);
+            y--;
+        }
+        else if ((dirs & NAV_LEFT) && dist[x - 1][y] == d)
+        {
+            path.push(GraphObject::left);
+            x--;
+        }
+        else
+        {
+            path.push(GraphObject::right);
+            x++;
+        }
+    }
+}
+
+void PathFinder::copyNavigation(unsigned char out[64][64]) const
+{
+    memcpy(out, m_grid->nav, sizeof(m_grid->nav));
+}
+
+bool PathFinder::isClearLine(int x, int y, int x2, int y2) const
+{
+    if (x < 0 || x > 60 || y < 0 || y > 60 || x2 < 0 || x2 > 60 || y2 < 0 || y2 > 60)
+        return false;
+
+    if (y == y2)
+    {
+        if (x2 > x)
+            return m_grid->blockedRight[x + 1][y] > x2;
+        if (x2 < x)
+            return m_grid->blockedLeft[x - 1][y] < x2;
+        return true;
+    }
+
+    if (x == x2)
+    {
+        if (y2 > y)
+            return m_grid->blockedUp[x][y + 1] > y2;
+        return m_grid->blockedDown[x][y - 1] < y2;
+    }
+
+    return false;
+}
+
+int PathFinder::getClearRun(int x, int y, GraphObject::Direction dir, int maxSteps) const
+{
+    int nx = x + (dir == GraphObject::left ? -1 : dir == GraphObject::right ? 1 : 0);
+    int ny = y + (dir == GraphObject::down ? -1 : dir == GraphObject::up ? 1 : 0);
+
+    if (dir == GraphObject::none || !isOpen(nx, ny))
+        return 0;
+
+    int run;
+
+    switch (dir)
+    {
+    case GraphObject::left:
+        run = nx - m_grid->blockedLeft[nx][ny];
+        break;
+    case GraphObject::right:
+        run = m_grid->blockedRight[nx][ny] - nx;
+        break;
+    case GraphObject::down:
+        run = ny - m_grid->blockedDown[nx][ny];
+        break;
+    default:
+        run = m_grid->blockedUp[nx][ny] - ny;
+        break;
+    }
+
+    return min(run, maxSteps);
+}
+
+// True when a lies in the same row or column as the player with nothing but
+// open cells between them.
+bool PathFinder::hasUnobstructedPathToPlayer(Actor* a)
+{
+    Actor* player = m_world->getPlayer();
+
+    return isClearLine(a->getX(), a->getY(), player->getX(), player->getY());
+}
+
+void PathFinder::requirePlayerFieldDepth(int maxMoves)
+{
+    if (maxMoves > m_playerFieldDepth)
+        m_playerFieldDepth = maxMoves;
+}
+
+void PathFinder::refreshPlayerField()
+{
+    Actor* player = m_world->getPlayer();
+    int px = player->getX();
+    int py = player->getY();
+
+    if (px == m_playerFieldX && py == m_playerFieldY && m_playerFieldVersion == m_gridVersion && m_playerFieldBuiltDepth == m_playerFieldDepth)
+        return;
+
+    m_playerFieldX = px;
+    m_playerFieldY = py;
+    m_playerFieldVersion = m_gridVersion;
+    m_playerFieldBuiltDepth = m_playerFieldDepth;
+
+    if (!m_playerField)
+        m_playerField.reset(new PlayerField());
+
+    PlayerField& f = *m_playerField;
+
+    // only the cells reached last time need resetting
+    for (int i = 0; i != f.nVisited; i++)
+        f.dist[f.visited[i] / 64][f.visited[i] % 64] = UNREACHABLE;
+
+    f.nVisited = 0;
+
+    if (px < 0 || px > 60 || py < 0 || py > 60)
+        return;
+
+    int head = 0;
+
+    f.dist[px][py] = 0;
+    f.visited[f.nVisited++] = px * 64 + py;
+
+    while (head != f.nVisited)
+    {
+        int x = f.visited[head] / 64;
+        int y = f.visited[head] % 64;
+        head++;
+
+        int next = f.dist[x][y] + 1;
+
+        if (next > m_playerFieldDepth)
+            continue;
+
+        unsigned char dirs = m_grid->nav[x][y];
+
+        if ((dirs & NAV_UP) && f.dist[x][y + 1] == UNREACHABLE)
+        {
+            f.dist[x][y + 1] = next;
+            f.visited[f.nVisited++] = x * 64 + y + 1;
+        }
+        if ((dirs & NAV_DOWN) && f.dist[x][y - 1] == UNREACHABLE)
+        {
+            f.dist[x][y - 1] = next;
+            f.visited[f.nVisited++] = x * 64 + y - 1;
+        }
+        if ((dirs & NAV_LEFT) && f.dist[x - 1][y] == UNREACHABLE)
+        {
+            f.dist[x - 1][y] = next;
+            f.visited[f.nVisited++] = (x - 1) * 64 + y;
+        }
+        if ((dirs & NAV_RIGHT) && f.dist[x + 1][y] == UNREACHABLE)
+        {
+            f.dist[x + 1][y] = next;
+            f.visited[f.nVisited++] = (x + 1) * 64 + y;
+        }
+    }
+}
+
+int PathFinder::getPlayerDistance(int x, int y)
+{
+    Actor* player = m_world->getPlayer();
+
+    if (!isReachable(x, y, player->getX(), player->getY()))
+        return UNREACHABLE;
+
+    refreshPlayerField();
+
+    return m_playerField->dist[x][y];
+}
+
+GraphObject::Direction PathFinder::getDirTowardsPlayer(int x, int y)
+{
+    int d = getPlayerDistance(x, y);
+
+    if (d == UNREACHABLE || d == 0)
+        return GraphObject::none;
+
+    unsigned char dirs = m_grid->nav[x][y];
+    const int (&dist)[64][64] = m_playerField->dist;
+
+    if ((dirs & NAV_UP) && dist[x][y + 1] == d - 1)
+        return GraphObject::up;
+    if ((dirs & NAV_DOWN) && dist[x][y - 1] == d - 1)
+        return GraphObject::down;
+    if ((dirs & NAV_LEFT) && dist[x - 1][y] == d - 1)
+        return GraphObject::left;
+
+    return GraphObject::right;
+}
@@ -0,0 +1,175 @@
+#ifndef PATHFINDER_H_
+#define PATHFINDER_H_
+
+#include "GraphObject.h"
+#include "PackedPath.h"
+#include "ConnectivityIndex.h"
+#include "Random.h"
+#include <memory>
+
+class StudentWorld;
+class IceManager;
+class Actor;
+
+// Per-cell navigation bits. The low four say which neighbouring anchors a
+// 4x4 actor at this anchor can step to; NAV_INTERSECTION is set when both a
+// horizontal and a vertical move are possible; NAV_OPEN when the anchor
+// itself is free of ice and boulders.
+const unsigned char NAV_UP = 1;
+const unsigned char NAV_DOWN = 2;
+const unsigned char NAV_LEFT = 4;
+const unsigned char NAV_RIGHT = 8;
+const unsigned char NAV_DIRS = NAV_UP | NAV_DOWN | NAV_LEFT | NAV_RIGHT;
+const unsigned char NAV_INTERSECTION = 16;
+const unsigned char NAV_OPEN = 32;
+
+class PathFinder
+{
+public:
+    PathFinder();
+
+    void init(StudentWorld* world, IceManager* ice);
+
+    // Takes other's navigation tables without copying them, for a cloned
+    // world whose map is the same. The player field is left to be built on
+    // first use, since the clone's player moves on its own.
+    void share(PathFinder& other, StudentWorld* world, IceManager* ice);
+
+    // Rebuilds the whole navigation table.
+    void updateGrid();
+
+    // Refreshes only the cells affected by a change to the 4-wide box of h
+    // rows anchored at (x, y), e.g. after it was dug out or a boulder left,
+    // arrived or fell a row.
+    void updateGrid(int x, int y, int h = 4);
+
+    bool isOpen(int x, int y) const;
+    unsigned char getValidDirections(int x, int y) const;
+    bool isIntersection(int x, int y) const;
+    unsigned char getValidPerpDirs(int x, int y, GraphObject::Direction dir) const;
+    bool canMove(int x, int y, GraphObject::Direction dir) const;
+
+    // Whether any route at all joins the two anchors, in near O(1).
+    bool isReachable(int x1, int y1, int x2, int y2);
+
+    static unsigned char toDirBit(GraphObject::Direction dir);
+
+    // Uniformly picks one of the directions set in dirs, or none if it is
+    // empty, using table lookups rather than a chain of branches.
+    static GraphObject::Direction chooseRandomDirection(unsigned char dirs, Random& rng);
+
+    // Both read one breadth-first field over the open anchors, rebuilt on
+    // first use after a change. There are no clusters: on a map of 61x61
+    // anchors the rebuild after a dig takes a couple of microseconds, less
+    // than refreshing one cluster's entrance costs would.
+
+    // Fills path with the shortest route from (x, y) to the exit at (60, 60);
+    // leaves it empty if there is no way out.
+    void getPathToExitFrom(int x, int y, PackedPath& path);
+
+    // Number of moves from (x, y) to the exit, or UNREACHABLE.
+    int getExitDistance(int x, int y);
+
+    // True when nothing blocks a straight horizontal or vertical walk from
+    // (x, y) to (x2, y2). Answered from the run tables below in O(1).
+    bool isClearLine(int x, int y, int x2, int y2) const;
+
+    // How many steps from (x, y) in dir pass only through open anchors, up
+    // to maxSteps.
+    int getClearRun(int x, int y, GraphObject::Direction dir, int maxSteps) const;
+    bool hasUnobstructedPathToPlayer(Actor* a);
+
+    // Hardcore protesters share one distance-from-player field, truncated at
+    // the largest move budget any of them has asked for. It is rebuilt lazily,
+    // and only after the player has moved or the map has changed.
+    void requirePlayerFieldDepth(int maxMoves);
+
+    // Moves from (x, y) to the player, or UNREACHABLE if more than the field
+    // depth.
+    int getPlayerDistance(int x, int y);
+
+    // The step from (x, y) that gets one move closer to the player, or none
+    // if the player is out of range.
+    GraphObject::Direction getDirTowardsPlayer(int x, int y);
+
+    // Bumped on every change to the navigation table.
+    unsigned int getGridVersion() const
+    {
+        return m_gridVersion;
+    }
+
+    // Carries on from a saved world's count, so routes planned there
+    // compare against it as they did.
+    void restoreGridVersion(unsigned int version)
+    {
+        m_gridVersion = version;
+    }
+
+    void copyNavigation(unsigned char out[64][64]) const;
+
+    // The exit-field search and walk, usable on a copy of the navigation
+    // table so a worker thread can plan without touching the live grid.
+    static void buildExitField(const unsigned char nav[64][64], int dist[64][64]);
+    static void walkExitField(const unsigned char nav[64][64], const int dist[64][64], int x, int y, PackedPath& path);
+
+    static const int UNREACHABLE = 1 << 20;
+
+private:
+    // Everything that follows from the map alone. Cloned worlds share one
+    // until either changes its map, when that world takes its own copy.
+    struct Grid
+    {
+        Grid();
+
+        unsigned char nav[64][64];
+        int exitDist[64][64];
+        ConnectivityIndex components;
+
+        // For each anchor, the nearest blocked anchor in each direction,
+        // itself included (-1 or 61 when the run reaches the edge).
+        signed char blockedLeft[64][64];
+        signed char blockedRight[64][64];
+        signed char blockedDown[64][64];
+        signed char blockedUp[64][64];
+        bool exitFieldDirty;
+    };
+
+    struct PlayerField
+    {
+        PlayerField();
+
+        int dist[64][64];
+        int visited[61 * 61];
+        int nVisited;
+    };
+
+    bool computeOpen(int x, int y) const;
+    void updateMask(Grid& g, int x, int y);
+    void buildExitField();
+    void refreshPlayerField();
+    void rebuildRow(Grid& g, int y);
+    void rebuildColumn(Grid& g, int x);
+
+    static std::shared_ptr<Grid> emptyGrid();
+
+    // The grid, copied first if another world is sharing it.
+    Grid& edit();
+
+    StudentWorld* m_world;
+    IceManager* m_ice;
+    std::shared_ptr<Grid> m_grid;
+
+    // made the first time a hardcore protester asks for it
+    std::unique_ptr<PlayerField> m_playerField;
+    int m_playerFieldDepth;
+    int m_playerFieldX;
+    int m_playerFieldY;
+    int m_playerFieldBuiltDepth;
+    unsigned int m_gridVersion;
+    unsigned int m_playerFieldVersion;
+
+    PathFinder(const PathFinder&);
+    PathFinder& operator=(const PathFinder&);
+};
+
+#endif // PATHFINDER_H_
@@ -0,0 +1,171 @@
+#include "PathRequestQueue.h"
+#include "PathFinder.h"
+#include "Actor.h"
+#include <algorithm>
+using namespace std;
+
+PathRequestQueue::PathRequestQueue()
+    : m_pathFinder(nullptr), m_budget(1), m_threaded(false),
+    m_frontValid(false), m_backReady(false),
+    m_busy(false), m_stop(false)
+{
+}
+
+PathRequestQueue::~PathRequestQueue()
+{
+    stopWorker();
+}
+
+void PathRequestQueue::init(PathFinder* pathFinder, int budget, bool threaded)
+{
+    m_pathFinder = pathFinder;
+    m_budget = budget < 1 ? 1 : budget;
+
+    if (threaded != m_threaded)
+    {
+        if (threaded)
+            startWorker();
+        else
+            stopWorker();
+    }
+
+    m_threaded = threaded;
+
+    // a field from the last level says nothing about this one, including
+    // one the worker is still building
+    unique_lock<mutex> lock(m_mutex);
+    while (m_busy)
+        m_done.wait(lock);
+
+    m_frontValid = false;
+    m_backReady = false;
+}
+
+void PathRequestQueue::submit(Protester* requester)
+{
+    if (find(m_queue.begin(), m_queue.end(), requester) == m_queue.end())
+        m_queue.push_back(requester);
+}
+
+void PathRequestQueue::cancel(Protester* requester)
+{
+    m_queue.erase(remove(m_queue.begin(), m_queue.end(), requester), m_queue.end());
+}
+
+void PathRequestQueue::clear()
+{
+    m_queue.clear();
+}
+
+int PathRequestQueue::position(const Protester* requester) const
+{
+    deque<Protester*>::const_iterator it = find(m_queue.begin(), m_queue.end(), requester);
+    return it == m_queue.end() ? -1 : (int)(it - m_queue.begin());
+}
+
+void PathRequestQueue::update()
+{
+    if (m_queue.empty())
+        return;
+
+    if (m_threaded)
+    {
+        refreshField();
+
+        if (!m_frontValid)
+            return;
+    }
+
+    for (int n = 0; n != m_budget && !m_queue.empty(); n++)
+    {
+        Protester* requester = m_queue.front();
+        m_queue.pop_front();
+
+        if (m_threaded)
+        {
+            PathFinder::walkExitField(m_front->nav, m_front->dist, requester->getX(), requester->getY(), m_result);
+            requester->receivePath(m_result, m_front->version);
+        }
+        else
+        {
+            m_pathFinder->getPathToExitFrom(requester->getX(), requester->getY(), m_result);
+            requester->receivePath(m_result, m_pathFinder->getGridVersion());
+        }
+    }
+}
+
+// Takes the worker's finished field, and sets it going on the current grid
+// if ours is out of date. Routes are walked from the newest finished field
+// in the meantime; protesters replan once the fresh one lands.
+void PathRequestQueue::refreshField()
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    if (m_busy)
+        return;
+
+    if (m_backReady)
+    {
+        m_front.swap(m_back);
+        m_frontValid = true;
+        m_backReady = false;
+    }
+
+    if (!m_frontValid || m_front->version != m_pathFinder->getGridVersion())
+    {
+        m_pathFinder->copyNavigation(m_back->nav);
+        m_back->version = m_pathFinder->getGridVersion();
+        m_busy = true;
+        m_wake.notify_one();
+    }
+}
+
+void PathRequestQueue::startWorker()
+{
+    if (!m_front)
+    {
+        m_front.reset(new Field());
+        m_back.reset(new Field());
+    }
+
+    m_stop = false;
+    m_worker = thread(&PathRequestQueue::workerLoop, this);
+}
+
+void PathRequestQueue::stopWorker()
+{
+    if (!m_worker.joinable())
+        return;
+
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_stop = true;
+        m_wake.notify_one();
+    }
+
+    m_worker.join();
+    m_busy = false;
+}
+
+void PathRequestQueue::workerLoop()
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    for (;;)
+    {
+        while (!m_busy && !m_stop)
+            m_wake.wait(lock);
+
+        if (m_stop)
+            return;
+
+        // the main thread leaves the back buffers alone while m_busy is set
+        lock.unlock();
+        PathFinder::buildExitField(m_back->nav, m_back->dist);
+        lock.lock();
+
+        m_busy = false;
+        m_backReady = true;
+        m_done.notify_one();
+    }
+}
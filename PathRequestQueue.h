@@ -0,0 +1,78 @@
+#ifndef PATHREQUESTQUEUE_H_
+#define PATHREQUESTQUEUE_H_
+
+#include "PackedPath.h"
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class PathFinder;
+class Protester;
+
+// Exit routes for protesters that have given up. A burst of them (a boulder
+// landing on a crowd, a run of bribes) would otherwise all plan in the same
+// tick, so requests are queued and at most a budget of them are answered per
+// tick, always on a tick after they were made. The route is planned from
+// where the protester is at delivery, so it can keep walking meanwhile.
+//
+// In threaded mode the exit-distance field is built by a worker from a copy
+// of the navigation table, and the main thread only walks the finished field.
+class PathRequestQueue
+{
+public:
+    PathRequestQueue();
+    ~PathRequestQueue();
+
+    void init(PathFinder* pathFinder, int budget, bool threaded);
+
+    void submit(Protester* requester);
+    void cancel(Protester* requester);
+    void clear();
+
+    // Where a request stands in the queue, or -1 if there is none.
+    int position(const Protester* requester) const;
+
+    // Once per tick, before the actors move.
+    void update();
+
+private:
+    void startWorker();
+    void stopWorker();
+    void workerLoop();
+    void refreshField();
+
+    PathFinder* m_pathFinder;
+    int m_budget;
+    bool m_threaded;
+    std::deque<Protester*> m_queue;
+    PackedPath m_result;
+
+    // An exit-distance field and the navigation table it was built from.
+    struct Field
+    {
+        unsigned char nav[64][64];
+        int dist[64][64];
+        unsigned int version;
+    };
+
+    // the field the main thread walks, and the one the worker is filling;
+    // only made in threaded mode
+    std::unique_ptr<Field> m_front;
+    bool m_frontValid;
+    std::unique_ptr<Field> m_back;
+    bool m_backReady;
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    bool m_busy;
+    bool m_stop;
+
+    PathRequestQueue(const PathRequestQueue&);
+    PathRequestQueue& operator=(const PathRequestQueue&);
+};
+
+#endif // PATHREQUESTQUEUE_H_
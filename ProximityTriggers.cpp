@@ -0,0 +1,127 @@
+#include "ProximityTriggers.h"
+#include "DistanceKernel.h"
+#include "Actor.h"
+#include <algorithm>
+#include <cstdlib>
+using namespace std;
+
+// std::max binds a reference to it
+const int ProximityTriggers::PICKUP_REACH;
+
+ProximityTriggers::ProximityTriggers()
+    : m_maxRadius(0), m_playerX(-1), m_playerY(-1), m_hasNew(false)
+{
+}
+
+int ProximityTriggers::cellOf(int coord)
+{
+    return min(max(coord, 0), 63) / CELL_SIZE;
+}
+
+void ProximityTriggers::add(Item* item, int revealRadius)
+{
+    Trigger t;
+    t.item = item;
+    t.x = item->getX();
+    t.y = item->getY();
+    t.revealDist2 = toDoubledRadiusSquared(revealRadius);
+    t.revealed = false;
+
+    m_cells[cellOf(t.x)][cellOf(t.y)].push_back(t);
+    m_maxRadius = max(m_maxRadius, max(revealRadius, PICKUP_REACH));
+
+    // an item placed right next to the player shouldn't wait for a move,
+    // but it shouldn't be collected while it's still being made either
+    m_hasNew = true;
+}
+
+void ProximityTriggers::remove(Item* item)
+{
+    vector<Trigger>& cell = m_cells[cellOf(item->getX())][cellOf(item->getY())];
+
+    for (vector<Trigger>::iterator it = cell.begin(); it != cell.end(); it++)
+    {
+        if (it->item == item)
+        {
+            cell.erase(it);
+            return;
+        }
+    }
+}
+
+void ProximityTriggers::clear()
+{
+    for (int i = 0; i != NUM_CELLS; i++)
+        for (int j = 0; j != NUM_CELLS; j++)
+            m_cells[i][j].clear();
+
+    m_maxRadius = 0;
+    m_playerX = -1;
+    m_playerY = -1;
+    m_hasNew = false;
+}
+
+void ProximityTriggers::playerMovedTo(int x, int y)
+{
+    if (x == m_playerX && y == m_playerY)
+        return;
+
+    m_playerX = x;
+    m_playerY = y;
+    m_hasNew = false;
+    evaluate(x, y, m_maxRadius, RevealAndPickup);
+}
+
+void ProximityTriggers::update()
+{
+    if (!m_hasNew || m_playerX < 0)
+        return;
+
+    m_hasNew = false;
+    evaluate(m_playerX, m_playerY, m_maxRadius, RevealAndPickup);
+}
+
+void ProximityTriggers::revealWithin(int x, int y, int radius)
+{
+    evaluate(x, y, radius, RevealOnly);
+}
+
+void ProximityTriggers::evaluate(int x, int y, int radius, Check check)
+{
+    int scanDist2 = toDoubledRadiusSquared(radius);
+
+    for (int i = cellOf(x - radius); i <= cellOf(x + radius); i++)
+    {
+        for (int j = cellOf(y - radius); j <= cellOf(y + radius); j++)
+        {
+            vector<Trigger>& cell = m_cells[i][j];
+
+            for (vector<Trigger>::iterator it = cell.begin(); it != cell.end();)
+            {
+                int dist2 = doubledDistSquared(it->x, it->y, x, y);
+                int revealDist2 = (check == RevealOnly ? scanDist2 : it->revealDist2);
+
+                if (!it->revealed && dist2 <= revealDist2)
+                {
+                    it->revealed = true;
+                    it->item->playerInRevealRange();
+                }
+
+                if (check == RevealAndPickup && abs(it->x - x) <= PICKUP_REACH && abs(it->y - y) <= PICKUP_REACH)
+                {
+                    m_pickedUp.push_back(it->item);
+                    it = cell.erase(it);
+                }
+                else
+                    it++;
+            }
+        }
+    }
+
+    // pickups may spawn or remove other triggers, so run them after the scan
+    vector<Item*> pickedUp;
+    pickedUp.swap(m_pickedUp);
+
+    for (size_t k = 0; k != pickedUp.size(); k++)
+        pickedUp[k]->playerInPickupRange();
+}
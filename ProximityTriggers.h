@@ -0,0 +1,62 @@
+#ifndef PROXIMITYTRIGGERS_H_
+#define PROXIMITYTRIGGERS_H_
+
+#include <vector>
+
+class Item;
+
+// Registry of items that react to the player coming close: hidden barrels and
+// gold that become visible within a reveal radius and are collected once the
+// player's 4x4 box overlaps theirs. Triggers are bucketed by grid cell and
+// only evaluated when the player's position changes, so an idle item costs
+// nothing per tick.
+class ProximityTriggers
+{
+public:
+    ProximityTriggers();
+
+    // Items added are first checked on the next update() or player move, not
+    // from inside their own constructor.
+    void add(Item* item, int revealRadius);
+    void remove(Item* item);
+    void clear();
+
+    // Called when the player moves to a new cell.
+    void playerMovedTo(int x, int y);
+
+    // Once per tick, before the actors move.
+    void update();
+
+    // Reveals every registered item within radius of (x, y), e.g. for sonar.
+    void revealWithin(int x, int y, int radius);
+
+private:
+    struct Trigger
+    {
+        Item* item;
+        int x;
+        int y;
+        int revealDist2;
+        bool revealed;
+    };
+
+    static const int CELL_SIZE = 8;
+    static const int NUM_CELLS = 64 / CELL_SIZE;
+
+    // anchors closer than this on both axes have overlapping 4x4 boxes
+    static const int PICKUP_REACH = 3;
+
+    enum Check { RevealOnly, RevealAndPickup };
+
+    void evaluate(int x, int y, int radius, Check check);
+    static int cellOf(int coord);
+
+    std::vector<Trigger> m_cells[NUM_CELLS][NUM_CELLS];
+    std::vector<Item*> m_pickedUp;
+    int m_maxRadius;
+    int m_playerX;
+    int m_playerY;
+    bool m_hasNew;
+};
+
+#endif // PROXIMITYTRIGGERS_H_
@@ -0,0 +1,56 @@
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+// Small seedable generator (xorshift64*). Unlike rand() each instance has its
+// own state, so a level can be regenerated from its seed and the state can
+// be saved and restored.
+class Random
+{
+public:
+    explicit Random(unsigned long long seed = 1)
+    {
+        setSeed(seed);
+    }
+
+    void setSeed(unsigned long long seed)
+    {
+        // xorshift must never hold zero
+        m_state = seed != 0 ? seed : 0x9E3779B97F4A7C15ULL;
+    }
+
+    unsigned long long getState() const
+    {
+        return m_state;
+    }
+
+    void setState(unsigned long long state)
+    {
+        setSeed(state);
+    }
+
+    unsigned long long next()
+    {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Uniform in [0, n).
+    int nextInt(int n)
+    {
+        return static_cast<int>((next() >> 33) % static_cast<unsigned long long>(n));
+    }
+
+    // Also uniform in [0, n), by a multiply and shift rather than nextInt's
+    // division, for hot loops whose n isn't a constant.
+    int nextIndex(int n)
+    {
+        return static_cast<int>(((next() >> 32) * static_cast<unsigned long long>(n)) >> 32);
+    }
+
+private:
+    unsigned long long m_state;
+};
+
+#endif // RANDOM_H_
@@ -0,0 +1,325 @@
+#include "Replay.h"
+#include "WorldSnapshot.h"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+static_assert(sizeof(ReplayHeader) == 48, "replay header layout changed");
+static_assert(sizeof(ReplayKeyframe) == 8, "replay keyframe layout changed");
+static_assert(sizeof(ReplayIndexEntry) == 16, "replay index layout changed");
+
+const char REPLAY_MAGIC[4] = { 'I', 'C', 'E', 'R' };
+
+// Keys are chars or the KEY_PRESS_ arrow codes, so anything larger is junk.
+const unsigned int MAX_KEY = 0xFFFF;
+const unsigned int KEYFRAME_CODE = 0;
+
+static size_t alignUp(size_t offset)
+{
+    return (offset + 7) & ~(size_t)7;
+}
+
+// Seven bits a byte, low bits first, with the top bit set on every byte but
+// the last.
+static void putVarint(vector<unsigned char>& out, unsigned int value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+static bool getVarint(const unsigned char*& pos, const unsigned char* end, unsigned int& value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 32 && pos != end; shift += 7)
+    {
+        unsigned char b = *pos++;
+        value |= (unsigned int)(b & 0x7F) << shift;
+
+        if ((b & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+// The keyframe whose code ends at pos, moving pos past its image. Null if
+// it runs past end.
+static const ReplayKeyframe* readKeyframe(const unsigned char* file, const unsigned char*& pos, const unsigned char* end)
+{
+    size_t offset = alignUp(pos - file);
+    size_t limit = end - file;
+
+    if (offset + sizeof(ReplayKeyframe) > limit)
+        return nullptr;
+
+    const ReplayKeyframe* keyframe = reinterpret_cast<const ReplayKeyframe*>(file + offset);
+
+    if (keyframe->size % 8 != 0 || keyframe->size > limit - offset - sizeof(ReplayKeyframe))
+        return nullptr;
+
+    pos = file + offset + sizeof(ReplayKeyframe) + keyframe->size;
+    return keyframe;
+}
+
+static bool tickBefore(unsigned int tick, const ReplayIndexEntry& entry)
+{
+    return tick < entry.tick;
+}
+
+ReplayRecorder::ReplayRecorder()
+    : m_seed(0), m_nEvents(0), m_lastEventTick(0), m_lastKeyframeTick(0), m_keyframeInterval(0),
+    m_isRecording(false)
+{
+}
+
+void ReplayRecorder::start(unsigned long long seed, int keyframeInterval)
+{
+    m_events.clear();
+    m_index.clear();
+    m_seed = seed;
+    m_nEvents = 0;
+    m_lastEventTick = 0;
+    m_lastKeyframeTick = 0;
+    m_keyframeInterval = keyframeInterval;
+    m_isRecording = true;
+}
+
+void ReplayRecorder::putEvent(unsigned int tick, unsigned int code)
+{
+    putVarint(m_events, tick - m_lastEventTick);
+    putVarint(m_events, code);
+    m_lastEventTick = tick;
+}
+
+void ReplayRecorder::record(unsigned int tick, int key)
+{
+    if (!m_isRecording)
+        return;
+
+    putEvent(tick, (unsigned int)key + 1);
+    m_nEvents++;
+}
+
+bool ReplayRecorder::wantsKeyframe(unsigned int tick) const
+{
+    return m_isRecording && m_keyframeInterval > 0 && tick - m_lastKeyframeTick >= (unsigned int)m_keyframeInterval;
+}
+
+void ReplayRecorder::addKeyframe(unsigned int tick, const vector<unsigned char>& image)
+{
+    putEvent(tick, KEYFRAME_CODE);
+
+    // offsets count from the start of the file
+    size_t offset = alignUp(sizeof(ReplayHeader) + m_events.size());
+    m_events.resize(offset - sizeof(ReplayHeader), 0);
+
+    ReplayIndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.tick = tick;
+    entry.offset = offset;
+    m_index.push_back(entry);
+
+    ReplayKeyframe keyframe;
+    keyframe.tick = tick;
+    keyframe.size = (uint32_t)image.size();
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(&keyframe);
+    m_events.insert(m_events.end(), p, p + sizeof(keyframe));
+    m_events.insert(m_events.end(), image.begin(), image.end());
+
+    m_lastKeyframeTick = tick;
+}
+
+bool ReplayRecorder::write(const string& path, unsigned int lastTick) const
+{
+    ReplayHeader h;
+    size_t indexOffset = alignUp(sizeof(ReplayHeader) + m_events.size());
+    const char padding[8] = { 0 };
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    h.version = ReplayPlayer::VERSION;
+    h.seed = m_seed;
+    h.nEvents = m_nEvents;
+    h.lastTick = lastTick;
+    h.nKeyframes = (uint32_t)m_index.size();
+    h.keyframeInterval = m_keyframeInterval;
+    h.streamSize = (uint32_t)m_events.size();
+    h.indexOffset = indexOffset;
+
+    ofstream out(path.c_str(), ios::binary);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    if (!m_events.empty())
+        out.write(reinterpret_cast<const char*>(&m_events[0]), m_events.size());
+    out.write(padding, indexOffset - sizeof(ReplayHeader) - m_events.size());
+    if (!m_index.empty())
+        out.write(reinterpret_cast<const char*>(&m_index[0]), m_index.size() * sizeof(ReplayIndexEntry));
+
+    return out.good();
+}
+
+ReplayPlayer::ReplayPlayer()
+    : m_pos(nullptr), m_end(nullptr), m_lastEventTick(0)
+{
+}
+
+bool ReplayPlayer::open(const string& path, string& error)
+{
+    m_pos = nullptr;
+    m_end = nullptr;
+    m_lastEventTick = 0;
+
+    if (!m_file.open(path))
+    {
+        error = "can't open " + path;
+        return false;
+    }
+
+    const unsigned char* data = m_file.getData();
+    size_t size = m_file.getSize();
+    const ReplayHeader& h = *reinterpret_cast<const ReplayHeader*>(data);
+    size_t streamEnd = 0;
+
+    if (size < sizeof(ReplayHeader) || memcmp(h.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0)
+        error = "not a replay";
+    else if (h.version != VERSION)
+        error = "unsupported replay version";
+    else if ((streamEnd = sizeof(ReplayHeader) + (size_t)h.streamSize) > size
+        || h.indexOffset != alignUp(streamEnd) || h.indexOffset > size
+        || (size - h.indexOffset) != (size_t)h.nKeyframes * sizeof(ReplayIndexEntry))
+        error = "bad layout";
+    else
+    {
+        // walk the whole stream once, so playback and seeking never meet a
+        // bad event
+        const ReplayIndexEntry* index = reinterpret_cast<const ReplayIndexEntry*>(data + h.indexOffset);
+        const unsigned char* pos = data + sizeof(ReplayHeader);
+        const unsigned char* end = data + streamEnd;
+        unsigned int tick = 0;
+        unsigned int nKeys = 0;
+        unsigned int nKeyframes = 0;
+
+        while (pos != end && error.empty())
+        {
+            unsigned int gap, code;
+
+            if (!getVarint(pos, end, gap) || !getVarint(pos, end, code))
+                error = "bad event";
+            else if (gap > h.lastTick - tick)
+                error = "event after the last tick";
+            else if (code != KEYFRAME_CODE)
+            {
+                if (code - 1 > MAX_KEY)
+                    error = "bad key";
+
+                tick += gap;
+                nKeys++;
+            }
+            else
+            {
+                tick += gap;
+
+                const ReplayKeyframe* keyframe = readKeyframe(data, pos, end);
+
+                if (keyframe == nullptr || keyframe->tick != tick || nKeyframes == h.nKeyframes
+                    || index[nKeyframes].tick != tick
+                    || index[nKeyframes].offset != (uint64_t)(reinterpret_cast<const unsigned char*>(keyframe) - data)
+                    || !validateSnapshot(reinterpret_cast<const unsigned char*>(keyframe + 1), keyframe->size))
+                    error = "bad keyframe";
+
+                nKeyframes++;
+            }
+        }
+
+        if (error.empty() && (nKeys != h.nEvents || nKeyframes != h.nKeyframes))
+            error = "wrong number of events";
+    }
+
+    if (!error.empty())
+    {
+        m_file.close();
+        return false;
+    }
+
+    m_pos = data + sizeof(ReplayHeader);
+    m_end = data + streamEnd;
+    return true;
+}
+
+unsigned long long ReplayPlayer::getSeed() const
+{
+    return reinterpret_cast<const ReplayHeader*>(m_file.getData())->seed;
+}
+
+unsigned int ReplayPlayer::getLastTick() const
+{
+    return reinterpret_cast<const ReplayHeader*>(m_file.getData())->lastTick;
+}
+
+bool ReplayPlayer::getKey(unsigned int tick, int& key)
+{
+    if (!isOpen())
+        return false;
+
+    while (m_pos != m_end)
+    {
+        const unsigned char* next = m_pos;
+        unsigned int gap, code;
+
+        getVarint(next, m_end, gap);
+        getVarint(next, m_end, code);
+
+        // a key is never due late when the game is played the same way, but
+        // one must not hold up the rest if it is
+        if (m_lastEventTick + gap > tick)
+            return false;
+
+        m_lastEventTick += gap;
+
+        // keyframes are only for seeking
+        if (code == KEYFRAME_CODE)
+            readKeyframe(m_file.getData(), next, m_end);
+
+        m_pos = next;
+
+        if (code != KEYFRAME_CODE)
+        {
+            key = (int)(code - 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ReplayPlayer::seek(unsigned int tick, const unsigned char*& image, size_t& size, unsigned int& keyframeTick)
+{
+    if (!isOpen())
+        return false;
+
+    const unsigned char* data = m_file.getData();
+    const ReplayHeader& h = *reinterpret_cast<const ReplayHeader*>(data);
+    const ReplayIndexEntry* index = reinterpret_cast<const ReplayIndexEntry*>(data + h.indexOffset);
+
+    // the one before the first keyframe past tick
+    const ReplayIndexEntry* entry = upper_bound(index, index + h.nKeyframes, tick, tickBefore);
+    if (entry == index)
+        return false;
+    --entry;
+
+    const ReplayKeyframe* keyframe = reinterpret_cast<const ReplayKeyframe*>(data + entry->offset);
+
+    image = reinterpret_cast<const unsigned char*>(keyframe + 1);
+    size = keyframe->size;
+    keyframeTick = keyframe->tick;
+
+    m_pos = image + size;
+    m_lastEventTick = keyframe->tick;
+    return true;
+}
@@ -0,0 +1,139 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A recorded game: the seed the first level was built from and every key
+// the player's getKey() accepted, stamped with the tick it arrived on.
+// Ticks count every move() of the game across deaths and levels, and all
+// game-logic randomness follows from the seed, so the two together replay
+// the game exactly.
+//
+// On disk (.rpl) the header is followed by the event stream, then the seek
+// index. Each event is the ticks since the previous event, then a code,
+// both varints: key + 1 for a key, or 0 for a keyframe. A keyframe is the
+// whole world as a snapshot (see WorldSnapshot.h) taken at the end of its
+// tick, stored on the next 8-byte boundary as a ReplayKeyframe and the
+// image, so it can be restored straight from the mapped file. The index
+// lists every keyframe, so a seek restores the last one before the tick
+// wanted and plays on at most one keyframe interval from there.
+struct ReplayHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t seed;
+    uint32_t nEvents;
+
+    // the last tick played, so a replay runs on past the final key
+    uint32_t lastTick;
+
+    uint32_t nKeyframes;
+    uint32_t keyframeInterval;
+
+    // the stream starts straight after the header; the index starts on
+    // the first 8-byte boundary after it
+    uint32_t streamSize;
+    uint32_t reserved;
+    uint64_t indexOffset;
+};
+
+struct ReplayKeyframe
+{
+    uint32_t tick;
+    uint32_t size;
+};
+
+struct ReplayIndexEntry
+{
+    uint32_t tick;
+    uint32_t reserved;
+
+    // of the ReplayKeyframe, from the start of the file
+    uint64_t offset;
+};
+
+class ReplayRecorder
+{
+public:
+    ReplayRecorder();
+
+    // Starts a fresh recording of a game seeded with seed, keeping a
+    // keyframe every keyframeInterval ticks (0 for none).
+    void start(unsigned long long seed, int keyframeInterval);
+
+    bool isRecording() const
+    {
+        return m_isRecording;
+    }
+
+    void record(unsigned int tick, int key);
+
+    // True once a keyframe is due at the end of tick.
+    bool wantsKeyframe(unsigned int tick) const;
+    void addKeyframe(unsigned int tick, const std::vector<unsigned char>& image);
+
+    // Writes everything so far, ending at lastTick. Can be called as often
+    // as wanted; each call replaces the file.
+    bool write(const std::string& path, unsigned int lastTick) const;
+
+private:
+    void putEvent(unsigned int tick, unsigned int code);
+
+    // everything after the header, up to the index
+    std::vector<unsigned char> m_events;
+    std::vector<ReplayIndexEntry> m_index;
+    unsigned long long m_seed;
+    unsigned int m_nEvents;
+    unsigned int m_lastEventTick;
+    unsigned int m_lastKeyframeTick;
+    int m_keyframeInterval;
+    bool m_isRecording;
+};
+
+// Plays a replay back from its mapped file, decoding one event at a time.
+class ReplayPlayer
+{
+public:
+    ReplayPlayer();
+
+    // Maps path and checks the whole event stream and index. On failure
+    // error says why.
+    bool open(const std::string& path, std::string& error);
+
+    bool isOpen() const
+    {
+        return m_pos != nullptr;
+    }
+
+    unsigned long long getSeed() const;
+    unsigned int getLastTick() const;
+
+    // True once every event has been handed out.
+    bool isFinished() const
+    {
+        return m_pos == m_end;
+    }
+
+    // The next key if it is due on tick, skipping any keyframes before it.
+    bool getKey(unsigned int tick, int& key);
+
+    // Finds the last keyframe at or before tick and carries on from just
+    // after it. False, leaving the player where it was, if there is none.
+    bool seek(unsigned int tick, const unsigned char*& image, size_t& size, unsigned int& keyframeTick);
+
+    static const uint32_t VERSION = 3;
+
+private:
+    MappedFile m_file;
+    const unsigned char* m_pos;
+    const unsigned char* m_end;
+    unsigned int m_lastEventTick;
+
+    ReplayPlayer(const ReplayPlayer&);
+    ReplayPlayer& operator=(const ReplayPlayer&);
+};
+
+#endif // REPLAY_H_
@@ -0,0 +1,188 @@
+#include "RewindBuffer.h"
+#include <cstring>
+using namespace std;
+
+// A delta slot holding far more than its delta is given the memory back.
+const size_t MAX_SLACK = 4096;
+
+static void putVarint(vector<unsigned char>& out, unsigned int value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+// Deltas never leave memory, so they need no checking.
+static unsigned int getVarint(const unsigned char*& pos)
+{
+    unsigned int value = 0;
+
+    for (int shift = 0; ; shift += 7)
+    {
+        unsigned char b = *pos++;
+        value |= (unsigned int)(b & 0x7F) << shift;
+
+        if ((b & 0x80) == 0)
+            return value;
+    }
+}
+
+static bool sameWord(const unsigned char* a, const unsigned char* b)
+{
+    return memcmp(a, b, 8) == 0;
+}
+
+// A delta is the new image's size in words, then runs of changed words: the
+// words skipped since the last run, the run's length, then its words. Words
+// past the end of the old image always count as changed.
+static void encodeDelta(const vector<unsigned char>& from, const vector<unsigned char>& to, vector<unsigned char>& out)
+{
+    unsigned int nFrom = from.size() / 8;
+    unsigned int nTo = to.size() / 8;
+    unsigned int lastRunEnd = 0;
+    unsigned int w = 0;
+
+    out.clear();
+    putVarint(out, nTo);
+
+    while (w < nTo)
+    {
+        if (w < nFrom && sameWord(&from[w * 8], &to[w * 8]))
+        {
+            w++;
+            continue;
+        }
+
+        unsigned int start = w;
+        while (w < nTo && (w >= nFrom || !sameWord(&from[w * 8], &to[w * 8])))
+            w++;
+
+        putVarint(out, start - lastRunEnd);
+        putVarint(out, w - start);
+        out.insert(out.end(), to.begin() + start * 8, to.begin() + w * 8);
+        lastRunEnd = w;
+    }
+}
+
+static void applyDelta(const vector<unsigned char>& delta, vector<unsigned char>& image)
+{
+    const unsigned char* pos = &delta[0];
+    const unsigned char* end = pos + delta.size();
+    unsigned int w = 0;
+
+    image.resize(getVarint(pos) * 8);
+
+    while (pos != end)
+    {
+        w += getVarint(pos);
+        unsigned int run = getVarint(pos);
+
+        memcpy(&image[w * 8], pos, run * 8);
+        pos += run * 8;
+        w += run;
+    }
+}
+
+RewindBuffer::RewindBuffer()
+    : m_head(0), m_count(0)
+{
+}
+
+void RewindBuffer::init(int ticks)
+{
+    // whole intervals, so the keyframe slots stay put as the ring wraps
+    int intervals = (ticks + KEYFRAME_INTERVAL - 1) / KEYFRAME_INTERVAL;
+    if (intervals < 1)
+        intervals = 1;
+
+    m_frames.assign(intervals * KEYFRAME_INTERVAL, Frame());
+    m_head = 0;
+    m_count = 0;
+    m_last.clear();
+}
+
+int RewindBuffer::slot(int age) const
+{
+    int size = m_frames.size();
+    return (m_head - m_count + age + size) % size;
+}
+
+unsigned int RewindBuffer::getTick() const
+{
+    return m_count > 0 ? m_frames[slot(m_count - 1)].tick : 0;
+}
+
+void RewindBuffer::push(unsigned int tick, const vector<unsigned char>& image)
+{
+    if (!isEnabled())
+        return;
+
+    Frame& f = m_frames[m_head];
+
+    f.tick = tick;
+    f.isKeyframe = m_head % KEYFRAME_INTERVAL == 0 || m_count == 0;
+
+    if (f.isKeyframe)
+        f.data = image;
+    else
+    {
+        encodeDelta(m_last, image, f.data);
+
+        // the odd big delta (the actors' slots being packed again, say)
+        // shouldn't pin that much memory in the slot for good
+        if (f.data.capacity() > 2 * f.data.size() + MAX_SLACK)
+            f.data.shrink_to_fit();
+    }
+
+    m_last = image;
+    m_head = (m_head + 1) % m_frames.size();
+
+    if (m_count < (int)m_frames.size())
+        m_count++;
+}
+
+bool RewindBuffer::rewind(unsigned int tick)
+{
+    if (m_count == 0)
+        return false;
+
+    int target = m_count - 1;
+    while (target > 0 && m_frames[slot(target)].tick > tick)
+        target--;
+
+    int base = target;
+    while (base >= 0 && !m_frames[slot(base)].isKeyframe)
+        base--;
+
+    // the frames before the oldest keyframe lost the one they build on
+    if (base < 0 || m_frames[slot(target)].tick > tick)
+    {
+        base = 0;
+        while (!m_frames[slot(base)].isKeyframe)
+            base++;
+
+        target = base;
+    }
+
+    m_last = m_frames[slot(base)].data;
+    for (int age = base + 1; age <= target; age++)
+        applyDelta(m_frames[slot(age)].data, m_last);
+
+    // play carries on from the frame rebuilt
+    m_head = (slot(target) + 1) % m_frames.size();
+    m_count = target + 1;
+    return true;
+}
+
+size_t RewindBuffer::getMemoryUse() const
+{
+    size_t bytes = m_frames.size() * sizeof(Frame) + m_last.capacity();
+
+    for (size_t i = 0; i != m_frames.size(); i++)
+        bytes += m_frames[i].data.capacity();
+
+    return bytes;
+}
@@ -0,0 +1,76 @@
+#ifndef REWINDBUFFER_H_
+#define REWINDBUFFER_H_
+
+#include <vector>
+#include <cstddef>
+
+// The last few hundred ticks of play, kept in memory so the world can be
+// wound back. Each frame is the world's snapshot image (see WorldSnapshot.h)
+// at the end of a tick, stored either whole or as the 8-byte words that
+// changed since the frame before. Most ticks move a few actors and clear
+// at most a 4x4 patch of ice, which is one word per ice row touched, so a
+// delta is usually a few dozen bytes.
+//
+// Whole frames sit in every KEYFRAME_INTERVAL-th slot of a fixed ring, so
+// rebuilding any frame applies fewer than that many deltas, and the delta
+// slots never grow to hold a whole image.
+class RewindBuffer
+{
+public:
+    RewindBuffer();
+
+    // Keeps (about) the last ticks frames, dropping anything kept so far.
+    void init(int ticks);
+
+    bool isEnabled() const
+    {
+        return !m_frames.empty();
+    }
+
+    // Adds the image of the world at the end of tick.
+    void push(unsigned int tick, const std::vector<unsigned char>& image);
+
+    // Drops every frame after the last one at or before tick (or the
+    // oldest that can still be rebuilt, if tick is older) and rebuilds that
+    // frame as getImage(). False if there is nothing to go back to.
+    bool rewind(unsigned int tick);
+
+    // The newest frame's image and tick.
+    const std::vector<unsigned char>& getImage() const
+    {
+        return m_last;
+    }
+
+    unsigned int getTick() const;
+
+    // Bytes held, for keeping an eye on the steady-state cost.
+    size_t getMemoryUse() const;
+
+    // Actors keep their records from one image to the next, so adding or
+    // removing one costs about its own record. What is left costs more: a
+    // protester walking out re-packs its route, shifting the routes after
+    // it, and the slots are packed again once removed actors' gaps outnumber
+    // the live ones, which makes one delta about as big as the records.
+    static const int KEYFRAME_INTERVAL = 32;
+
+private:
+    struct Frame
+    {
+        unsigned int tick;
+        bool isKeyframe;
+        std::vector<unsigned char> data;
+    };
+
+    // slot of the age-th oldest frame
+    int slot(int age) const;
+
+    std::vector<Frame> m_frames;
+    int m_head;
+    int m_count;
+    std::vector<unsigned char> m_last;
+
+    RewindBuffer(const RewindBuffer&);
+    RewindBuffer& operator=(const RewindBuffer&);
+};
+
+#endif // REWINDBUFFER_H_
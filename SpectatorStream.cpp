@@ -0,0 +1,546 @@
+#include "SpectatorStream.h"
+#include "GraphObject.h"
+#include "IceManager.h"
+#include <cstring>
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#endif
+
+using namespace std;
+
+static_assert(sizeof(SpectatorHeader) == 8, "spectator header layout changed");
+
+const char SPECTATOR_MAGIC[4] = { 'I', 'C', 'E', 'V' };
+
+// Frames waiting for the writer past this are dropped for a fresh start.
+const size_t MAX_BACKLOG = 1 << 20;
+const unsigned int MAX_FRAME = 1 << 24;
+
+static void putVarint(vector<unsigned char>& out, unsigned int value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+static bool getVarint(const unsigned char*& pos, const unsigned char* end, unsigned int& value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 32 && pos != end; shift += 7)
+    {
+        unsigned char b = *pos++;
+        value |= (unsigned int)(b & 0x7F) << shift;
+
+        if ((b & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+// Small negative numbers stay small.
+static void putSigned(vector<unsigned char>& out, int value)
+{
+    putVarint(out, ((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+}
+
+// PackBits: a control byte n below 128 is followed by n + 1 literal bytes,
+// and n from 128 up by one byte repeated n - 125 times (3 to 130). Ice rows
+// and unchanged fields are mostly runs.
+static void packBits(const vector<unsigned char>& in, vector<unsigned char>& out)
+{
+    size_t n = in.size();
+    size_t i = 0;
+
+    out.clear();
+
+    while (i < n)
+    {
+        size_t run = 1;
+        while (i + run < n && run < 130 && in[i + run] == in[i])
+            run++;
+
+        if (run >= 3)
+        {
+            out.push_back((unsigned char)(run + 125));
+            out.push_back(in[i]);
+            i += run;
+            continue;
+        }
+
+        // literals up to the next run worth packing
+        size_t start = i;
+        while (i < n && i - start < 128)
+        {
+            if (i + 2 < n && in[i] == in[i + 1] && in[i] == in[i + 2])
+                break;
+            i++;
+        }
+
+        out.push_back((unsigned char)(i - start - 1));
+        out.insert(out.end(), in.begin() + start, in.begin() + i);
+    }
+}
+
+static bool unpackBits(const unsigned char* pos, size_t size, size_t rawSize, vector<unsigned char>& out)
+{
+    const unsigned char* end = pos + size;
+
+    out.clear();
+
+    while (pos != end)
+    {
+        unsigned int control = *pos++;
+
+        if (control < 128)
+        {
+            size_t length = control + 1;
+            if ((size_t)(end - pos) < length)
+                return false;
+
+            out.insert(out.end(), pos, pos + length);
+            pos += length;
+        }
+        else
+        {
+            if (pos == end)
+                return false;
+
+            out.insert(out.end(), control - 125, *pos++);
+        }
+
+        if (out.size() > rawSize)
+            return false;
+    }
+
+    return out.size() == rawSize;
+}
+
+bool isSpectatorHeader(const unsigned char* data, size_t size)
+{
+    const SpectatorHeader* h = reinterpret_cast<const SpectatorHeader*>(data);
+
+    return size >= sizeof(SpectatorHeader) && memcmp(h->magic, SPECTATOR_MAGIC, sizeof(SPECTATOR_MAGIC)) == 0
+        && h->version == SPECTATOR_VERSION;
+}
+
+SpectatorFrameStatus readSpectatorFrame(const unsigned char*& pos, const unsigned char* end, vector<unsigned char>& payload)
+{
+    const unsigned char* p = pos;
+    unsigned int rawSize, storedSize;
+
+    if (p == end)
+        return SPEC_FRAME_INCOMPLETE;
+
+    unsigned int encoding = *p++;
+
+    if (encoding > 1)
+        return SPEC_FRAME_BAD;
+
+    // a varint cut short may just not have arrived yet
+    if (!getVarint(p, end, rawSize) || !getVarint(p, end, storedSize))
+        return p == end ? SPEC_FRAME_INCOMPLETE : SPEC_FRAME_BAD;
+
+    if (rawSize > MAX_FRAME || storedSize > MAX_FRAME || (encoding == 0 && storedSize != rawSize))
+        return SPEC_FRAME_BAD;
+
+    if ((size_t)(end - p) < storedSize)
+        return SPEC_FRAME_INCOMPLETE;
+
+    if (encoding == 0)
+        payload.assign(p, p + storedSize);
+    else if (!unpackBits(p, storedSize, rawSize, payload))
+        return SPEC_FRAME_BAD;
+
+    pos = p + storedSize;
+    return SPEC_FRAME_OK;
+}
+
+SpectatorStream::SpectatorStream()
+    : m_compress(false), m_tick(0), m_frame(0), m_nextID(1), m_resync(false), m_stop(false)
+#ifdef _WIN32
+    , m_file(INVALID_HANDLE_VALUE)
+#else
+    , m_fd(-1)
+#endif
+{
+    memset(m_iceRows, 0, sizeof(m_iceRows));
+    memset(m_stats, -1, sizeof(m_stats));
+}
+
+SpectatorStream::~SpectatorStream()
+{
+    close();
+}
+
+void SpectatorStream::open(const string& path, bool compress)
+{
+    close();
+
+    m_path = path;
+    m_compress = compress;
+    m_shown.clear();
+    memset(m_iceRows, 0, sizeof(m_iceRows));
+    m_text.clear();
+    m_sentText.clear();
+    memset(m_stats, -1, sizeof(m_stats));
+    m_tick = 0;
+    m_frame = 0;
+    m_nextID = 1;
+    m_pending.clear();
+    m_resync = false;
+    m_stop = false;
+
+#ifndef _WIN32
+    // a viewer closing its end of the pipe must not take the game down
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    m_worker = thread(&SpectatorStream::writerLoop, this);
+}
+
+void SpectatorStream::close()
+{
+    if (!isOpen())
+        return;
+
+    m_payload.clear();
+    putVarint(m_payload, m_tick);
+    m_payload.push_back(SPEC_END);
+    send();
+
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_stop = true;
+        m_wake.notify_one();
+    }
+
+    m_worker.join();
+}
+
+void SpectatorStream::setText(const string& text)
+{
+    m_text = text;
+}
+
+void SpectatorStream::beginTick(unsigned int tick, int level, int lives, int score)
+{
+    bool resync;
+
+    m_tick = tick;
+    m_frame++;
+    m_payload.clear();
+    putVarint(m_payload, tick);
+
+    {
+        unique_lock<mutex> lock(m_mutex);
+
+        // a viewer that can't keep up, or hasn't turned up yet, starts
+        // afresh rather than from an ever longer queue
+        if (m_pending.size() > MAX_BACKLOG)
+        {
+            m_pending.clear();
+            m_resync = true;
+        }
+
+        resync = m_resync;
+        m_resync = false;
+    }
+
+    if (resync)
+    {
+        m_payload.push_back(SPEC_RESET);
+        m_shown.clear();
+        memset(m_iceRows, 0, sizeof(m_iceRows));
+        m_sentText.clear();
+        memset(m_stats, -1, sizeof(m_stats));
+    }
+
+    if (level != m_stats[0] || lives != m_stats[1] || score != m_stats[2])
+    {
+        m_payload.push_back(SPEC_STATS);
+        putVarint(m_payload, level);
+        putVarint(m_payload, lives);
+        putVarint(m_payload, score);
+        m_stats[0] = level;
+        m_stats[1] = lives;
+        m_stats[2] = score;
+    }
+
+    if (m_text != m_sentText)
+    {
+        m_payload.push_back(SPEC_TEXT);
+        putVarint(m_payload, m_text.size());
+        m_payload.insert(m_payload.end(), m_text.begin(), m_text.end());
+        m_sentText = m_text;
+    }
+}
+
+void SpectatorStream::setIce(const IceManager& ice)
+{
+    for (int y = 0; y != 64; y++)
+    {
+        unsigned long long row = ice.getRow(y);
+
+        if (row == m_iceRows[y])
+            continue;
+
+        m_payload.push_back(SPEC_ICE);
+        putVarint(m_payload, y);
+        for (int i = 0; i != 8; i++)
+            m_payload.push_back((unsigned char)(row >> (8 * i)));
+
+        m_iceRows[y] = row;
+    }
+}
+
+void SpectatorStream::addObject(const GraphObject* object)
+{
+    Shown now;
+
+    now.frame = m_frame;
+    now.image = object->getID();
+    now.x = object->getX();
+    now.y = object->getY();
+    now.direction = object->getDirection();
+    now.depth = object->getDepth();
+    now.size = roundAwayFromZero(object->getSize() * 100);
+    now.brightness = roundAwayFromZero(object->getBrightness() * 100);
+    now.visible = object->isVisible();
+
+    unordered_map<const GraphObject*, Shown>::iterator it = m_shown.find(object);
+    bool isNew = it == m_shown.end();
+
+    if (isNew)
+        now.id = m_nextID++;
+    else
+    {
+        const Shown& was = it->second;
+        now.id = was.id;
+
+        if (now.image == was.image && now.direction == was.direction && now.depth == was.depth
+            && now.size == was.size && now.brightness == was.brightness && now.visible == was.visible)
+        {
+            if (now.x != was.x || now.y != was.y)
+            {
+                m_payload.push_back(SPEC_MOVE);
+                putVarint(m_payload, now.id);
+                putSigned(m_payload, now.x);
+                putSigned(m_payload, now.y);
+            }
+
+            it->second = now;
+            return;
+        }
+    }
+
+    m_payload.push_back(SPEC_SET);
+    putVarint(m_payload, now.id);
+    putVarint(m_payload, now.image);
+    putSigned(m_payload, now.x);
+    putSigned(m_payload, now.y);
+    m_payload.push_back((unsigned char)now.direction);
+    putVarint(m_payload, now.depth);
+    putVarint(m_payload, now.size);
+    putVarint(m_payload, now.brightness);
+    m_payload.push_back(now.visible ? 1 : 0);
+
+    m_shown[object] = now;
+}
+
+void SpectatorStream::endTick()
+{
+    // anything not added this tick has gone
+    unordered_map<const GraphObject*, Shown>::iterator it = m_shown.begin();
+
+    while (it != m_shown.end())
+    {
+        if (it->second.frame == m_frame)
+        {
+            it++;
+            continue;
+        }
+
+        m_payload.push_back(SPEC_REMOVE);
+        putVarint(m_payload, it->second.id);
+        it = m_shown.erase(it);
+    }
+
+    send();
+}
+
+void SpectatorStream::send()
+{
+    const vector<unsigned char>* stored = &m_payload;
+    unsigned char encoding = 0;
+
+    if (m_compress)
+    {
+        packBits(m_payload, m_packed);
+
+        if (m_packed.size() < m_payload.size())
+        {
+            stored = &m_packed;
+            encoding = 1;
+        }
+    }
+
+    unique_lock<mutex> lock(m_mutex);
+    m_pending.push_back(encoding);
+    putVarint(m_pending, m_payload.size());
+    putVarint(m_pending, stored->size());
+    m_pending.insert(m_pending.end(), stored->begin(), stored->end());
+    m_wake.notify_one();
+}
+
+void SpectatorStream::writerLoop()
+{
+    SpectatorHeader h;
+    vector<unsigned char> batch;
+    bool connected = false;
+    bool everConnected = false;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SPECTATOR_MAGIC, sizeof(SPECTATOR_MAGIC));
+    h.version = SPECTATOR_VERSION;
+
+    for (;;)
+    {
+        if (!connected)
+        {
+            connected = openOutput() && writeOutput(reinterpret_cast<const unsigned char*>(&h), sizeof(h));
+
+            if (!connected)
+            {
+                closeOutput();
+
+                unique_lock<mutex> lock(m_mutex);
+                if (m_stop)
+                    break;
+                m_wake.wait_for(lock, chrono::milliseconds(100));
+                continue;
+            }
+
+            // a new viewer on the pipe has seen none of it
+            if (everConnected)
+            {
+                unique_lock<mutex> lock(m_mutex);
+                m_pending.clear();
+                m_resync = true;
+            }
+            everConnected = true;
+        }
+
+        {
+            unique_lock<mutex> lock(m_mutex);
+
+            while (m_pending.empty() && !m_stop)
+                m_wake.wait(lock);
+
+            if (m_pending.empty())
+                break;
+
+            batch.swap(m_pending);
+        }
+
+        // the viewer has gone; wait for another
+        if (!writeOutput(&batch[0], batch.size()))
+        {
+            closeOutput();
+            connected = false;
+        }
+
+        batch.clear();
+    }
+
+    closeOutput();
+}
+
+#ifdef _WIN32
+
+bool SpectatorStream::openOutput()
+{
+    m_file = CreateFileA(m_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return m_file != INVALID_HANDLE_VALUE;
+}
+
+bool SpectatorStream::writeOutput(const unsigned char* data, size_t size)
+{
+    while (size > 0)
+    {
+        DWORD written;
+        if (!WriteFile(m_file, data, (DWORD)size, &written, nullptr))
+            return false;
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+void SpectatorStream::closeOutput()
+{
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+
+    m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool SpectatorStream::openOutput()
+{
+    // opening a named pipe for writing fails straight away while nobody is
+    // reading it, instead of blocking, so the writer can try again later
+    m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+    return m_fd >= 0;
+}
+
+bool SpectatorStream::writeOutput(const unsigned char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = ::write(m_fd, data, size);
+
+        if (n > 0)
+        {
+            data += n;
+            size -= n;
+            continue;
+        }
+
+        // a full pipe: give the viewer a moment, unless the game is closing
+        if (n < 0 && errno == EAGAIN && !m_stop)
+        {
+            this_thread::sleep_for(chrono::milliseconds(5));
+            continue;
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+void SpectatorStream::closeOutput()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+
+    m_fd = -1;
+}
+
+#endif
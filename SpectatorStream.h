@@ -0,0 +1,143 @@
+#ifndef SPECTATORSTREAM_H_
+#define SPECTATORSTREAM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class GraphObject;
+class IceManager;
+
+// What a viewer needs to draw the game, sent as it changes, one frame per
+// tick. The stream is a SpectatorHeader, then frames: an encoding byte (0
+// raw, 1 run-length packed), the payload's size and the stored size as
+// varints, then the stored bytes. A payload is the tick, then events:
+//
+//   SPEC_RESET                     forget everything shown so far
+//   SPEC_SET id image x y dir depth size brightness visible
+//                                  show an object, or replace it
+//   SPEC_MOVE id x y
+//   SPEC_REMOVE id
+//   SPEC_ICE row bits              one row of ice, 8 bytes little-endian
+//   SPEC_TEXT length chars         the status line
+//   SPEC_STATS level lives score
+//   SPEC_END                       the game is over
+//
+// Numbers are varints, x and y zigzagged, size and brightness in
+// hundredths, and dir and visible single bytes.
+struct SpectatorHeader
+{
+    char magic[4];
+    uint32_t version;
+};
+
+enum SpectatorEvent
+{
+    SPEC_RESET, SPEC_SET, SPEC_MOVE, SPEC_REMOVE, SPEC_ICE, SPEC_TEXT, SPEC_STATS, SPEC_END
+};
+
+enum SpectatorFrameStatus
+{
+    SPEC_FRAME_OK, SPEC_FRAME_INCOMPLETE, SPEC_FRAME_BAD
+};
+
+const uint32_t SPECTATOR_VERSION = 1;
+
+// Checks a stream's header.
+bool isSpectatorHeader(const unsigned char* data, size_t size);
+
+// Takes the frame at pos if it is all there, unpacking its payload into
+// payload and moving pos past it.
+SpectatorFrameStatus readSpectatorFrame(const unsigned char*& pos, const unsigned char* end,
+    std::vector<unsigned char>& payload);
+
+// Sends the game to a file or a named pipe for a viewer (see
+// SpectatorWorld). Frames are built on the game thread and written by a
+// worker, so a slow viewer, or none yet on a pipe, never holds a tick up:
+// if too much piles up it is dropped and the viewer is sent the whole
+// picture afresh.
+class SpectatorStream
+{
+public:
+    SpectatorStream();
+    ~SpectatorStream();
+
+    void open(const std::string& path, bool compress);
+
+    bool isOpen() const
+    {
+        return m_worker.joinable();
+    }
+
+    // The status line for the tick under way.
+    void setText(const std::string& text);
+
+    // A tick's frame: beginTick(), the ice and every object on show, then
+    // endTick().
+    void beginTick(unsigned int tick, int level, int lives, int score);
+    void setIce(const IceManager& ice);
+    void addObject(const GraphObject* object);
+    void endTick();
+
+private:
+    struct Shown
+    {
+        unsigned int id;
+        unsigned int frame;
+        int image;
+        int x;
+        int y;
+        int direction;
+        int depth;
+        int size;
+        int brightness;
+        bool visible;
+    };
+
+    void close();
+    void send();
+    void writerLoop();
+    bool openOutput();
+    bool writeOutput(const unsigned char* data, size_t size);
+    void closeOutput();
+
+    std::string m_path;
+    bool m_compress;
+
+    // the viewer's picture as of the last frame
+    std::unordered_map<const GraphObject*, Shown> m_shown;
+    unsigned long long m_iceRows[64];
+    std::string m_text;
+    std::string m_sentText;
+    int m_stats[3];
+    unsigned int m_tick;
+    unsigned int m_frame;
+    unsigned int m_nextID;
+
+    std::vector<unsigned char> m_payload;
+    std::vector<unsigned char> m_packed;
+
+    // shared with the writer
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<unsigned char> m_pending;
+    bool m_resync;
+    std::atomic<bool> m_stop;
+
+#ifdef _WIN32
+    void* m_file;
+#else
+    int m_fd;
+#endif
+
+    SpectatorStream(const SpectatorStream&);
+    SpectatorStream& operator=(const SpectatorStream&);
+};
+
+#endif // SPECTATORSTREAM_H_
@@ -0,0 +1,392 @@
+#include "SpectatorWorld.h"
+#include "SpectatorStream.h"
+#include "GraphObject.h"
+#include <iostream>
+#include <cstring>
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+using namespace std;
+
+// Frames queued past this are applied without being drawn.
+const size_t MAX_LAG = 10;
+
+// Ice as the game makes it (see Ice in Actor.cpp).
+const double ICE_SIZE = 0.25;
+const unsigned int ICE_DEPTH = 3;
+
+static bool getVarint(const unsigned char*& pos, const unsigned char* end, unsigned int& value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 32 && pos != end; shift += 7)
+    {
+        unsigned char b = *pos++;
+        value |= (unsigned int)(b & 0x7F) << shift;
+
+        if ((b & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static bool getSigned(const unsigned char*& pos, const unsigned char* end, int& value)
+{
+    unsigned int zigzag;
+
+    if (!getVarint(pos, end, zigzag))
+        return false;
+
+    value = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+    return true;
+}
+
+static bool getByte(const unsigned char*& pos, const unsigned char* end, unsigned int& value)
+{
+    if (pos == end)
+        return false;
+
+    value = *pos++;
+    return true;
+}
+
+SpectatorWorld::SpectatorWorld(string assetDir, const string& path)
+    : GameWorld(assetDir), m_path(path), m_hasHeader(false), m_ended(false), m_stop(false)
+#ifdef _WIN32
+    , m_file(INVALID_HANDLE_VALUE)
+#else
+    , m_fd(-1)
+#endif
+{
+    memset(m_ice, 0, sizeof(m_ice));
+}
+
+SpectatorWorld::~SpectatorWorld()
+{
+    m_stop = true;
+    if (m_reader.joinable())
+        m_reader.join();
+
+    clearPicture();
+}
+
+int SpectatorWorld::init()
+{
+    if (!m_reader.joinable())
+        m_reader = thread(&SpectatorWorld::readerLoop, this);
+
+    setGameStatText("Waiting for " + m_path);
+    return GWSTATUS_CONTINUE_GAME;
+}
+
+int SpectatorWorld::move()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_buffer.insert(m_buffer.end(), m_incoming.begin(), m_incoming.end());
+        m_incoming.clear();
+    }
+
+    const unsigned char* start = m_buffer.data();
+    const unsigned char* pos = start;
+    const unsigned char* end = start + m_buffer.size();
+    bool isBad = false;
+
+    if (!m_hasHeader && m_buffer.size() >= sizeof(SpectatorHeader))
+    {
+        isBad = !isSpectatorHeader(pos, m_buffer.size());
+        pos += sizeof(SpectatorHeader);
+        m_hasHeader = true;
+    }
+
+    while (m_hasHeader && !isBad)
+    {
+        vector<unsigned char> payload;
+        SpectatorFrameStatus status = readSpectatorFrame(pos, end, payload);
+
+        if (status != SPEC_FRAME_OK)
+        {
+            isBad = status == SPEC_FRAME_BAD;
+            break;
+        }
+
+        m_frames.push_back(vector<unsigned char>());
+        m_frames.back().swap(payload);
+    }
+
+    m_buffer.erase(m_buffer.begin(), m_buffer.begin() + (pos - start));
+
+    // catch up, then show a frame a tick like the game did
+    while (!isBad && !m_ended && !m_frames.empty())
+    {
+        isBad = !applyFrame(m_frames.front());
+        m_frames.pop_front();
+
+        if (m_frames.size() < MAX_LAG)
+            break;
+    }
+
+    if (isBad)
+    {
+        cout << m_path << ": not a broadcast, or a damaged one" << endl;
+        m_ended = true;
+    }
+
+    if (!m_ended)
+        return GWSTATUS_CONTINUE_GAME;
+
+    // no lives left is how the controller knows the game is over
+    restoreStats(getLevel(), 0, getScore());
+    return GWSTATUS_PLAYER_DIED;
+}
+
+void SpectatorWorld::cleanUp()
+{
+    clearPicture();
+}
+
+bool SpectatorWorld::applyFrame(const vector<unsigned char>& payload)
+{
+    const unsigned char* pos = payload.data();
+    const unsigned char* end = pos + payload.size();
+    unsigned int tick;
+
+    if (!getVarint(pos, end, tick))
+        return false;
+
+    while (pos != end)
+    {
+        unsigned int event = *pos++;
+
+        if (event == SPEC_RESET)
+            clearPicture();
+        else if (event == SPEC_SET)
+        {
+            unsigned int id, image, dir, depth, size, brightness, visible;
+            int x, y;
+
+            if (!getVarint(pos, end, id) || !getVarint(pos, end, image) || !getSigned(pos, end, x)
+                || !getSigned(pos, end, y) || !getByte(pos, end, dir) || !getVarint(pos, end, depth)
+                || !getVarint(pos, end, size) || !getVarint(pos, end, brightness) || !getByte(pos, end, visible)
+                || dir > GraphObject::right || depth >= NUM_LAYERS || size == 0)
+                return false;
+
+            GraphObject*& object = m_objects[id];
+
+            // the image, layer and size are fixed once an object is made
+            if (object != nullptr && (object->getID() != image || object->getDepth() != depth
+                || roundAwayFromZero(object->getSize() * 100) != (int)size))
+            {
+                delete object;
+                object = nullptr;
+            }
+
+            if (object == nullptr)
+                object = new GraphObject(image, x, y, (GraphObject::Direction)dir, size / 100.0, depth);
+
+            object->moveTo(x, y);
+            object->setDirection((GraphObject::Direction)dir);
+            object->setBrightness(brightness / 100.0);
+            object->setVisible(visible != 0);
+        }
+        else if (event == SPEC_MOVE)
+        {
+            unsigned int id;
+            int x, y;
+
+            if (!getVarint(pos, end, id) || !getSigned(pos, end, x) || !getSigned(pos, end, y))
+                return false;
+
+            unordered_map<unsigned int, GraphObject*>::iterator it = m_objects.find(id);
+            if (it == m_objects.end())
+                return false;
+
+            it->second->moveTo(x, y);
+        }
+        else if (event == SPEC_REMOVE)
+        {
+            unsigned int id;
+
+            if (!getVarint(pos, end, id))
+                return false;
+
+            unordered_map<unsigned int, GraphObject*>::iterator it = m_objects.find(id);
+            if (it == m_objects.end())
+                return false;
+
+            delete it->second;
+            m_objects.erase(it);
+        }
+        else if (event == SPEC_ICE)
+        {
+            unsigned int y;
+
+            if (!getVarint(pos, end, y) || y >= 64 || end - pos < 8)
+                return false;
+
+            unsigned long long row = 0;
+            for (int i = 0; i != 8; i++)
+                row |= (unsigned long long)*pos++ << (8 * i);
+
+            setIceRow(y, row);
+        }
+        else if (event == SPEC_TEXT)
+        {
+            unsigned int length;
+
+            if (!getVarint(pos, end, length) || (unsigned int)(end - pos) < length)
+                return false;
+
+            setGameStatText(string(reinterpret_cast<const char*>(pos), length));
+            pos += length;
+        }
+        else if (event == SPEC_STATS)
+        {
+            unsigned int level, lives, score;
+
+            if (!getVarint(pos, end, level) || !getVarint(pos, end, lives) || !getVarint(pos, end, score))
+                return false;
+
+            restoreStats(level, lives, score);
+        }
+        else if (event == SPEC_END)
+            m_ended = true;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+void SpectatorWorld::setIceRow(int y, unsigned long long row)
+{
+    for (int x = 0; x != 64; x++)
+    {
+        GraphObject*& ice = m_ice[y][x];
+        bool hasIce = (row >> x) & 1;
+
+        if (hasIce && ice == nullptr)
+        {
+            ice = new GraphObject(IID_ICE, x, y, GraphObject::right, ICE_SIZE, ICE_DEPTH);
+            ice->setVisible(true);
+        }
+        else if (!hasIce && ice != nullptr)
+        {
+            delete ice;
+            ice = nullptr;
+        }
+    }
+}
+
+void SpectatorWorld::clearPicture()
+{
+    unordered_map<unsigned int, GraphObject*>::iterator it;
+
+    for (it = m_objects.begin(); it != m_objects.end(); it++)
+        delete it->second;
+    m_objects.clear();
+
+    for (int y = 0; y != 64; y++)
+        setIceRow(y, 0);
+}
+
+void SpectatorWorld::readerLoop()
+{
+    unsigned char chunk[64 * 1024];
+    bool isOpen = false;
+
+    while (!m_stop)
+    {
+        int n = 0;
+
+        if (!isOpen)
+            isOpen = openInput();
+
+        if (isOpen)
+            n = readInput(chunk, sizeof(chunk));
+
+        if (n < 0)
+        {
+            closeInput();
+            isOpen = false;
+        }
+
+        // nothing yet: the game hasn't started, or is between ticks
+        if (n <= 0)
+        {
+            this_thread::sleep_for(chrono::milliseconds(20));
+            continue;
+        }
+
+        lock_guard<mutex> lock(m_mutex);
+        m_incoming.insert(m_incoming.end(), chunk, chunk + n);
+    }
+
+    closeInput();
+}
+
+#ifdef _WIN32
+
+bool SpectatorWorld::openInput()
+{
+    m_file = CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    return m_file != INVALID_HANDLE_VALUE;
+}
+
+int SpectatorWorld::readInput(unsigned char* data, size_t size)
+{
+    DWORD n;
+
+    if (!ReadFile(m_file, data, (DWORD)size, &n, nullptr))
+        return -1;
+
+    return (int)n;
+}
+
+void SpectatorWorld::closeInput()
+{
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+
+    m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool SpectatorWorld::openInput()
+{
+    // non-blocking, so a pipe with no game on the other end yet doesn't
+    // hold up stopping
+    m_fd = ::open(m_path.c_str(), O_RDONLY | O_NONBLOCK);
+    return m_fd >= 0;
+}
+
+int SpectatorWorld::readInput(unsigned char* data, size_t size)
+{
+    ssize_t n = ::read(m_fd, data, size);
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return 0;
+
+    return (int)n;
+}
+
+void SpectatorWorld::closeInput()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+
+    m_fd = -1;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef SPECTATORWORLD_H_
+#define SPECTATORWORLD_H_
+
+#include "GameWorld.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+class GraphObject;
+
+// Watches a game sent by SpectatorStream instead of playing one. Each object
+// in the stream gets a bare GraphObject standing in for it, so the usual
+// GameController and SpriteManager drawing shows the game as it was played.
+// The file or pipe is read on a worker, and is followed as it grows. Every
+// frame is a delta on the one before, so a viewer that falls behind applies
+// the frames it missed in one go and draws only the last, rather than
+// lagging further.
+class SpectatorWorld : public GameWorld
+{
+public:
+    SpectatorWorld(std::string assetDir, const std::string& path);
+    virtual ~SpectatorWorld();
+
+    virtual int init();
+    virtual int move();
+    virtual void cleanUp();
+
+private:
+    // Shows one frame. False if it doesn't make sense.
+    bool applyFrame(const std::vector<unsigned char>& payload);
+    void setIceRow(int y, unsigned long long row);
+    void clearPicture();
+
+    void readerLoop();
+    bool openInput();
+    int readInput(unsigned char* data, size_t size);
+    void closeInput();
+
+    std::string m_path;
+    std::unordered_map<unsigned int, GraphObject*> m_objects;
+    GraphObject* m_ice[64][64];
+
+    // bytes not yet made into frames, and frames not yet shown
+    std::vector<unsigned char> m_buffer;
+    bool m_hasHeader;
+    std::deque<std::vector<unsigned char> > m_frames;
+    bool m_ended;
+
+    // shared with the reader
+    std::thread m_reader;
+    std::mutex m_mutex;
+    std::vector<unsigned char> m_incoming;
+    std::atomic<bool> m_stop;
+
+#ifdef _WIN32
+    void* m_file;
+#else
+    int m_fd;
+#endif
+
+    SpectatorWorld(const SpectatorWorld&);
+    SpectatorWorld& operator=(const SpectatorWorld&);
+};
+
+#endif // SPECTATORWORLD_H_
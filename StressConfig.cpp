@@ -0,0 +1,154 @@
+#include "StressConfig.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+using namespace std;
+
+// give-up routes answered per tick outside stress mode
+const int NORMAL_PATH_BUDGET = 4;
+
+StressConfig::StressConfig()
+    : m_enabled(false),
+    m_maxProtesters(-1),
+    m_ticksBetweenProtesters(-1),
+    m_protestersPerSpawn(1),
+    m_goodieChance(-1),
+    m_nBoulders(-1),
+    m_nGold(-1),
+    m_nBarrels(-1),
+    m_spawnAnywhere(true),
+    m_reportPath("stress_report.csv"),
+    m_pathBudget(NORMAL_PATH_BUDGET),
+    m_pathThread(false)
+{
+}
+
+static int overrideOr(int value, int levelDefault)
+{
+    return value >= 0 ? value : levelDefault;
+}
+
+int StressConfig::getMaxProtesters(int levelDefault) const
+{
+    return m_enabled ? overrideOr(m_maxProtesters, levelDefault) : levelDefault;
+}
+
+int StressConfig::getTicksBetweenProtesters(int levelDefault) const
+{
+    return m_enabled ? overrideOr(m_ticksBetweenProtesters, levelDefault) : levelDefault;
+}
+
+int StressConfig::getProtestersPerSpawn() const
+{
+    return m_enabled ? m_protestersPerSpawn : 1;
+}
+
+int StressConfig::getGoodieChance(int levelDefault) const
+{
+    // a chance of 0 would divide by zero in move(), so clamp to "every tick"
+    int chance = m_enabled ? overrideOr(m_goodieChance, levelDefault) : levelDefault;
+    return chance < 1 ? 1 : chance;
+}
+
+int StressConfig::getNumBoulders(int levelDefault) const
+{
+    return m_enabled ? overrideOr(m_nBoulders, levelDefault) : levelDefault;
+}
+
+int StressConfig::getNumGold(int levelDefault) const
+{
+    return m_enabled ? overrideOr(m_nGold, levelDefault) : levelDefault;
+}
+
+int StressConfig::getNumBarrels(int levelDefault) const
+{
+    return m_enabled ? overrideOr(m_nBarrels, levelDefault) : levelDefault;
+}
+
+bool StressConfig::spawnAnywhere() const
+{
+    return m_enabled && m_spawnAnywhere;
+}
+
+string StressConfig::getReportPath() const
+{
+    return m_reportPath;
+}
+
+int StressConfig::getPathBudget() const
+{
+    return m_enabled ? m_pathBudget : NORMAL_PATH_BUDGET;
+}
+
+bool StressConfig::usePathThread() const
+{
+    return m_enabled && m_pathThread;
+}
+
+bool StressConfig::setOption(const string& key, const string& value)
+{
+    if (key == "report")
+    {
+        m_reportPath = value;
+        return true;
+    }
+
+    int n = atoi(value.c_str());
+
+    if (key == "protesters")
+        m_maxProtesters = n;
+    else if (key == "rate")
+        m_ticksBetweenProtesters = n;
+    else if (key == "burst")
+        m_protestersPerSpawn = n < 1 ? 1 : n;
+    else if (key == "goodies")
+        m_goodieChance = n;
+    else if (key == "boulders")
+        m_nBoulders = n;
+    else if (key == "gold")
+        m_nGold = n;
+    else if (key == "barrels")
+        m_nBarrels = n;
+    else if (key == "anywhere")
+        m_spawnAnywhere = n != 0;
+    else if (key == "pathbudget")
+        m_pathBudget = n < 1 ? 1 : n;
+    else if (key == "paththread")
+        m_pathThread = n != 0;
+    else
+        return false;
+
+    return true;
+}
+
+void StressConfig::parseArgs(int& argc, char* argv[])
+{
+    int kept = 1;
+    bool inStressArgs = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+
+        if (arg == "-stress")
+        {
+            m_enabled = true;
+            inStressArgs = true;
+            continue;
+        }
+
+        string::size_type eq = arg.find('=');
+
+        if (inStressArgs && eq != string::npos)
+        {
+            if (!setOption(arg.substr(0, eq), arg.substr(eq + 1)))
+                cout << "Ignoring unknown stress option " << arg << endl;
+            continue;
+        }
+
+        inStressArgs = false;
+        argv[kept++] = argv[i];
+    }
+
+    argc = kept;
+}
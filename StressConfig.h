@@ -0,0 +1,68 @@
+#ifndef STRESSCONFIG_H_
+#define STRESSCONFIG_H_
+
+#include <string>
+
+// Overrides for the per-level spawning rules, used to push the world far past
+// the normal caps so the cost of a tick can be measured against actor count.
+// A value of -1 means "use the normal level rule".
+//
+// Enabled from the command line, e.g.
+//   IceMan -stress protesters=10000 rate=1 goodies=10 boulders=9 report=stress.csv
+// pathbudget and paththread tune how give-up routes are planned (see
+// PathRequestQueue). The options that set up and play a game are in
+// GameOptions.
+class StressConfig
+{
+public:
+
+    bool isEnabled() const
+    {
+        return m_enabled;
+    }
+
+    int getMaxProtesters(int levelDefault) const;
+    int getTicksBetweenProtesters(int levelDefault) const;
+    int getProtestersPerSpawn() const;
+    int getGoodieChance(int levelDefault) const;
+    int getNumBoulders(int levelDefault) const;
+    int getNumGold(int levelDefault) const;
+    int getNumBarrels(int levelDefault) const;
+    bool spawnAnywhere() const;
+    std::string getReportPath() const;
+    int getPathBudget() const;
+    bool usePathThread() const;
+
+    // Consumes any stress arguments from argv so the rest can go to GLUT.
+    void parseArgs(int& argc, char* argv[]);
+
+    // Meyers singleton pattern
+    static StressConfig& getInstance()
+    {
+        static StressConfig instance;
+        return instance;
+    }
+
+private:
+    StressConfig();
+
+    bool setOption(const std::string& key, const std::string& value);
+
+    bool m_enabled;
+    int m_maxProtesters;
+    int m_ticksBetweenProtesters;
+    int m_protestersPerSpawn;
+    int m_goodieChance;
+    int m_nBoulders;
+    int m_nGold;
+    int m_nBarrels;
+    bool m_spawnAnywhere;
+    std::string m_reportPath;
+    int m_pathBudget;
+    bool m_pathThread;
+
+    StressConfig(const StressConfig&);
+    StressConfig& operator=(const StressConfig&);
+};
+
+#endif // STRESSCONFIG_H_
@@ -1,285 +1,343 @@
 #include "StudentWorld.h"
+#include "DistanceKernel.h"
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <cmath>
 #include <iomanip>
+#include <chrono>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
 
 using namespace std;
 
+GameWorld* createStudentWorld(string assetDir)
+{
+    return new StudentWorld(assetDir);
+}
+
+const int MAX_SPAWN_TRIES = 64;
+const char* const CHECKPOINT_PATH = "checkpoint.snap";
+const unsigned int REWIND_TICKS = 50;
+
+// A level's own spawn rule if it has one, otherwise the normal rule.
+static int levelRuleOr(int value, int normalRule)
+{
+    return value >= 0 ? value : normalRule;
+}
+
+static int levelError(const string& path, const string& error)
+{
+    cout << "Bad level data in " << path << ": " << error << endl;
+    return GWSTATUS_LEVEL_ERROR;
+}
+
+// Fills m_levelData for the level from the level file or pack if one was
+// given, otherwise from the generator.
+int StudentWorld::loadLevel(int level)
+{
+    GameOptions& options = GameOptions::getInstance();
+    string error;
+
+    if (!options.getLevelFile().empty())
+    {
+        // mapped afresh each time, so an edited file is picked up on restart
+        if (!m_levelFile.open(options.getLevelFile(), error))
+            return levelError(options.getLevelFile(), error);
+
+        m_levelFile.getLevel(level, m_levelData);
+        return GWSTATUS_CONTINUE_GAME;
+    }
+
+    if (!options.getLevelPack().empty())
+    {
+        // mapped once for the whole game
+        if (!m_levelPack.isOpen() && !m_levelPack.open(options.getLevelPack(), error))
+            return levelError(options.getLevelPack(), error);
+
+        // getting through every level in the pack wins
+        if (level >= m_levelPack.getCount())
+            return GWSTATUS_PLAYER_WON;
+
+        if (!m_levelPack.getLevel(level, m_levelData, error))
+            return levelError(options.getLevelPack(), error);
+
+        return GWSTATUS_CONTINUE_GAME;
+    }
+
+    // normally prepared in the background while the last level was played;
+    // after a death the same level is rebuilt from a fresh seed here
+    if (!m_prefetcher.take(level, m_nextSeed, m_levelData))
+        m_levelGenerator.buildLevel(level, m_nextSeed, m_levelData);
+
+    m_nextSeed = m_levelData.nextSeed;
+    m_prefetcher.request(level + 1, m_nextSeed);
+
+    return GWSTATUS_CONTINUE_GAME;
+}
+
+int StudentWorld::init()
+{
+    ActiveWorld active(this);
+    GameOptions& options = GameOptions::getInstance();
+    StressConfig& config = StressConfig::getInstance();
+
+    // kept across deaths and levels; winding back would put a recording or
+    // replay out of step with its keys
+    if (!m_rewind.isEnabled() && options.getRewindTicks() > 0 && options.getRecordPath().empty()
+        && options.getReplayPath().empty())
+        m_rewind.init(options.getRewindTicks());
+
+    // one broadcast for the whole game, from the world being played; the
+    // headless worlds of a replay run or a benchmark would open a second
+    // writer on the same path
+    if (!m_spectator.isOpen() && !options.getBroadcastPath().empty() && !GraphObject::isHeadless() && !m_isClone)
+        m_spectator.open(options.getBroadcastPath(), options.compressBroadcast());
+
+    if (m_startFromSnapshot)
+    {
+        m_startFromSnapshot = false;
+
+        string path = options.getRestorePath();
+        if (!readSnapshot(path))
+            return levelError(path, "not a snapshot this build can restore");
+
+        return GWSTATUS_CONTINUE_GAME;
+    }
+
+    // a new game: everything after follows from the first level's seed and
+    // the keys, so that is all a replay keeps
+    if (m_tick == 0)
+    {
+        if (!options.getReplayPath().empty())
+        {
+            string error;
+            if (!m_replay.open(options.getReplayPath(), error))
+                return levelError(options.getReplayPath(), error);
+
+            m_nextSeed = m_replay.getSeed();
+            m_seekTick = min((unsigned int)options.getSeekTick(), m_replay.getLastTick());
+        }
+
+        // otherwise the seed comes from the srand() in main
+        if (m_nextSeed == 0)
+            m_nextSeed = (unsigned long long)rand() << 32 | (unsigned int)rand();
+
+        // a game joined part way through can't be replayed from its seed
+        if (!options.getRecordPath().empty() && m_seekTick == 0)
+        {
+            m_recordPath = options.getRecordPath();
+            m_recorder.start(m_nextSeed, options.getKeyframeInterval());
+        }
+    }
+
+    int level = getLevel();
+    int status = loadLevel(level);
+
+    if (status != GWSTATUS_CONTINUE_GAME)
+        return status;
+
+    m_rng.setState(m_levelData.rngState);
+
+    m_iceManager.fill(m_levelData.iceRows);
+
+    m_iceman = new Iceman();
+    m_triggers.playerMovedTo(m_iceman->getX(), m_iceman->getY());
+
+    pickedBarrels = 0;
+    nProtesters = 0;
+    m_protesterGeneration = 0;
+    ticksToWaitToAddProtester = levelRuleOr(m_levelData.ticksBetweenProtesters, max(25, 200 - level));
+    ticksSinceLastProtester = ticksToWaitToAddProtester;
+
+    // oversized stress counts just get as many as fit
+    const vector<Placement>& boulders = m_levelData.boulders;
+    const vector<Placement>& gold = m_levelData.gold;
+    const vector<Placement>& barrels = m_levelData.barrels;
+
+    nBoulders = boulders.size();
+    nGold = gold.size();
+    nBarrels = barrels.size();
+
+    for (size_t i = 0; i != boulders.size(); i++)
+        Actors.push_back(new Boulder(boulders[i].x, boulders[i].y));
+
+    for (size_t i = 0; i != gold.size(); i++)
+        Actors.push_back(new GoldNugget(gold[i].x, gold[i].y, Item::States::Permanent));
+
+    for (size_t i = 0; i != barrels.size(); i++)
+        Actors.push_back(new OilBarrel(barrels[i].x, barrels[i].y));
+
+    m_pathFinder.init(this, &m_iceManager);
+    m_pathRequests.init(&m_pathFinder, config.getPathBudget(), config.usePathThread());
+
+    // the level is set up, so a replay can now jump ahead
+    if (m_seekTick > 0)
+    {
+        unsigned int tick = m_seekTick;
+        m_seekTick = 0;
+
+        if (!seekReplay(tick))
+            return levelError(options.getReplayPath(), "the game ends before the tick to seek to");
+    }
+
+    return GWSTATUS_CONTINUE_GAME;
+}
+
 bool StudentWorld::removeIce(int x, int y)
 {
-    bool rv = false;
-    for (int i = 0; i < nIce; i++)
-        if (IcePointers[i] != nullptr)
-            if (IcePointers[i]->getX() >= x && IcePointers[i]->getX() <= x + 3 && IcePointers[i]->getY() >= y && IcePointers[i]->getY() <= y + 3)
-            {
-                delete IcePointers[i];
-                IcePointers[i] = nullptr;
-                rv = true;
-            }
-    return rv;
+    return m_iceManager.clearIce(x, y);
 }
 
 bool StudentWorld::NearIceman(int x, int y, int amount)
 {
-    int square = pow(m_iceman->getX() - x, 2) + pow(m_iceman->getY() - y, 2);
-    if (sqrt(square) <= amount)
-        return true;
+    return doubledDistSquared(m_iceman->getX(), m_iceman->getY(), x, y) <= toDoubledRadiusSquared(amount);
+}
 
-    return false;
+// Refreshes the distance from every actor to the player in one pass. Called
+// once per tick after the player has moved; the slot stored in each actor
+// indexes the result for the rest of the tick.
+void StudentWorld::updatePlayerDistances()
+{
+    int n = Actors.size();
+
+    m_centreX.resize(n);
+    m_centreY.resize(n);
+    m_distToPlayer.resize(n);
+
+    for (int i = 0; i != n; i++)
+    {
+        Actors[i]->setSlot(i);
+        m_centreX[i] = toDoubledCentre(Actors[i]->getX());
+        m_centreY[i] = toDoubledCentre(Actors[i]->getY());
+    }
+
+    if (n > 0)
+        computeDistancesSquared(&m_centreX[0], &m_centreY[0], n, toDoubledCentre(m_iceman->getX()), toDoubledCentre(m_iceman->getY()), &m_distToPlayer[0]);
+}
+
+// Squared centre-to-centre distance to the player in doubled coordinates;
+// compare against toDoubledRadiusSquared(r). Actors spawned after this tick's
+// updatePlayerDistances() aren't in the table yet and are measured directly.
+int StudentWorld::getDistSquaredToPlayer(Actor* a)
+{
+    int slot = a->getSlot();
+
+    if (slot >= 0 && slot < (int)m_distToPlayer.size() && Actors[slot] == a && m_centreX[slot] == toDoubledCentre(a->getX()) && m_centreY[slot] == toDoubledCentre(a->getY()))
+        return m_distToPlayer[slot];
+
+    return doubledDistSquared(a->getX(), a->getY(), m_iceman->getX(), m_iceman->getY());
+}
+
+void StudentWorld::scan(int x, int y)
+{
+    m_triggers.revealWithin(x, y, 12);
 }
 
 void StudentWorld::boulderAnnoyActors(int x, int y)
 {
     if (m_iceman->getX() >= x - 3 && m_iceman->getX() <= x + 3 && m_iceman->getY() >= y - 3 && m_iceman->getY() <= y + 3)
-        m_iceman->giveUp();
+        m_iceman->takeDamage(Actor::rockFall);
 
-    annoyProtester(x, y, 100);
+    annoyProtester(x, y, Actor::rockFall);
 
 }
 
-bool StudentWorld::annoyProtester(int x, int y, int amt)
+bool StudentWorld::annoyProtester(int x, int y, Actor::DamageSource src)
 {
     bool rv = false;
-    std::vector<Actor*>::iterator it;
-    for (it = Actors.begin(); it != Actors.end(); it++)
+    std::vector<Protester*>::iterator it;
+    for (it = m_protesters.begin(); it != m_protesters.end(); it++)
     {
         if ((*it)->getX() >= x - 3 && (*it)->getX() <= x + 3 && (*it)->getY() >= y - 3 && (*it)->getY() <= y + 3)
-            if ((*it)->isProtester() && (*it)->getState() != "leave-oil-field")
+            if ((*it)->isAlive() && (*it)->getState() != Protester::LeaveOilField)
             {
-                (*it)->takeDamage(amt);
+                (*it)->takeDamage(src);
                 rv = true;
             }
     }
 
     return rv;
 }
-void StudentWorld::setPositions(int x, int y, char actortype)
+
+bool StudentWorld::boulderInBox(int x, int y)
 {
-    for (int i = x; i != x + 4; i++)
-        for (int j = y; j != y + 4; j++)
-            ActorPositions[i][j] = actortype;
+    return m_occupancy.anyInBox(OCC_BOULDER, x, y);
 }
 
-void StudentWorld::squirtWater(int x, int y, GraphObject::Direction dir)
+void StudentWorld::pickupBarrel(int x, int y)
 {
-    Actors.push_back(new Squirt(x, y, this, dir));
-    GameController::getInstance().playSound(SOUND_PLAYER_SQUIRT);
+    pickedBarrels++;
 }
 
-bool StudentWorld::isBoulder(int x, int y, GraphObject::Direction dir)
+bool StudentWorld::playerDied()
 {
-    switch (dir)
-    {
-    case GraphObject::right:
-        if (getPositions(x + 3, y) == 'B' || getPositions(x + 3, y + 3) == 'B')
-            return true;
-        break;
-    case GraphObject::left:
-        if (getPositions(x, y) == 'B' || getPositions(x, y + 3) == 'B')
-            return true;
-        break;
-    case GraphObject::up:
-        if (getPositions(x, y + 3) == 'B' || getPositions(x + 3, y + 3) == 'B')
-            return true;
-        break;
-    case GraphObject::down:
-        if (getPositions(x, y) == 'B' || getPositions(x + 3, y) == 'B')
-            return true;
-        break;
-    }
-    return false;
+    if (m_iceman->isAlive())
+        return false;
+
+    playSound(SOUND_PLAYER_GIVE_UP);
+    decLives();
+    return true;
 }
 
-bool StudentWorld::isIce(int x, int y, GraphObject::Direction dir)
+bool StudentWorld::finishedLevel()
 {
-    switch (dir)
+    if (pickedBarrels < nBarrels)
+        return false;
+
+    playSound(SOUND_FINISHED_LEVEL);
+    return true;
+}
+
+Actor* StudentWorld::collisionWith(Actor* a, BoundingBox box)
+{
+    Point corner = box.getXY();
+    Actor* found = nullptr;
+
+    for (size_t i = 0; i <= Actors.size(); i++)
     {
-    case GraphObject::down:
-        for (int i = 0; i < nIce; i++)
-            if (IcePointers[i] != nullptr)
-                if (IcePointers[i]->getX() >= x && IcePointers[i]->getX() <= x + 3 && IcePointers[i]->getY() == y)
-                    return true;
-        break;
-    case GraphObject::up:
-        for (int i = 0; i < nIce; i++)
-            if (IcePointers[i] != nullptr)
-                if (IcePointers[i]->getX() >= x && IcePointers[i]->getX() <= x + 3 && IcePointers[i]->getY() == y + 3)
-                    return true;
-        break;
+        Actor* other = i == Actors.size() ? m_iceman : Actors[i];
 
-    case GraphObject::right:
-        for (int i = 0; i < nIce; i++)
-            if (IcePointers[i] != nullptr)
-                if (IcePointers[i]->getY() >= y && IcePointers[i]->getY() <= y + 3 && IcePointers[i]->getX() == x + 3)
-                    return true;
-        break;
-    case GraphObject::left:
-        for (int i = 0; i < nIce; i++)
-            if (IcePointers[i] != nullptr)
-                if (IcePointers[i]->getY() >= y && IcePointers[i]->getY() <= y + 3 && IcePointers[i]->getX() == x)
-                    return true;
-        break;
+        if (other == a || !other->isAlive())
+            continue;
 
+        if (abs(other->getX() - corner.getX()) <= 3 && abs(other->getY() - corner.getY()) <= 3)
+        {
+            if (!other->isPassable())
+                return other;
+
+            if (found == nullptr)
+                found = other;
+        }
     }
 
-    return false;
+    return found;
 }
 
-
-bool StudentWorld::noIcenoBoulder(int x, int y, GraphObject::Direction dir)
+void StudentWorld::acceptActor(Actor* a)
 {
-    if (!isIce(x, y, dir) && !isBoulder(x, y, dir))
-        return true;
-    return false;
+    Actors.push_back(a);
 }
 
-bool StudentWorld::canFall(int x, int y)
+void StudentWorld::hitESC()
 {
-    if (y < 0)
-        return false;
-    if (!noIcenoBoulder(x, y, GraphObject::down))
-        return false;
-    return true;
+    m_iceman->setDead();
 }
 
-//bool StudentWorld::canShout(int x, int y, GraphObject::Direction dir)
-//{
-//    switch(dir)
-//    {
-//        case GraphObject::left:
-//            if(x<= m_iceman -> getX() + 4 && x >= m_iceman -> getX() && y < m_iceman -> getY() + 4 && y > m_iceman -> getY() - 4)
-//                return true;
-//            break;
-//        case GraphObject::right:
-//            if(x>= m_iceman -> getX() - 4 && x <= m_iceman -> getX() && y < m_iceman -> getY() + 4 && y > m_iceman -> getY() - 4)
-//                return true;
-//            break;
-//        case GraphObject::up:
-//            if(y>= m_iceman -> getY() - 4 && y<= m_iceman -> getY() && x < m_iceman -> getX() + 4 && x > m_iceman -> getX() - 4)
-//                return true;
-//            break;
-//        case GraphObject::down:
-//            if(y<= m_iceman -> getY() + 4  && y >= m_iceman -> getY() && x < m_iceman -> getX() + 4 && x > m_iceman -> getX() - 4)
-//                return true;
-//            break;
-//    }
-//    return false;
-//}
-
-//bool StudentWorld::finishedLevel()
-//{
-//    if (pickedBarrels == nBarrels)
-//    {
-//        GameController::getInstance().playSound(SOUND_FINISHED_LEVEL);
-//        return true;
-//    }
-//    return false;
-//}
-
-//bool StudentWorld::playerDied()
-//{
-//    bool rv = false;
-//    if (!m_iceman -> isAlive())
-//    {
-//        rv = true;
-//        decLives();
-//    }
-//
-//    return rv;
-//}
-
-//int StudentWorld::generateNewDir(int x, int y)
-//{
-//    int newDir = rand() % 4+1;
-//    switch (newDir) {
-//        case 1:
-//            if(!noIcenoBoulder(x, y+1, GraphObject::up) || y == 60)
-//                return generateNewDir(x, y);
-//            else
-//                return 1;
-//            break;
-//
-//        case 2:
-//            if(!noIcenoBoulder(x, y-1, GraphObject::down) || y == 0)
-//                return generateNewDir(x, y);
-//            else
-//                return 2;
-//            break;
-//
-//        case 3:
-//            if(!noIcenoBoulder(x-1, y, GraphObject::left) || x == 0)
-//                return generateNewDir(x, y);
-//            else
-//                return 3;
-//            break;
-//
-//        case 4:
-//            if(!noIcenoBoulder(x+1, y, GraphObject::right) || x == 60)
-//                return generateNewDir(x, y);
-//            else
-//                return 4;
-//            break;
-//    }
-//
-//    return 0;
-//}
-
-void StudentWorld::pickupBarrel(int x, int y)
+int StudentWorld::getProtesterCap()
 {
-    setPositions(x, y, 0);
-    pickedBarrels++;
+    int cap = levelRuleOr(m_levelData.maxProtesters, min<unsigned int>(15, 2 + getLevel() * 1.5));
+    return StressConfig::getInstance().getMaxProtesters(cap);
 }
 
-//bool StudentWorld::canFace(int x, int y, GraphObject::Direction& dir)
-//{
-//    bool rv = false;
-//    if(x>= m_iceman -> getX() - 63 && x < m_iceman -> getX() - 4 && y < m_iceman -> getY() + 4 && y > m_iceman -> getY() - 4 && !NearIceman(x, y, 4))
-//    {
-//        rv = true;
-//        dir = GraphObject::right;
-//        for(int i = x; i != m_iceman -> getX(); i++)
-//            if(!noIcenoBoulder(i, y, GraphObject::right))
-//                rv = false;
-//    }
-//
-//    else if(x<= m_iceman -> getX() + 63 && x > m_iceman -> getX() + 4 && y < m_iceman -> getY() + 4 && y > m_iceman -> getY() - 4 && !NearIceman(x, y, 4))
-//    {
-//        rv = true;
-//        dir = GraphObject::left;
-//        for(int i = x; i != m_iceman -> getX(); i--)
-//            if(!noIcenoBoulder(i, y, GraphObject::left))
-//                rv = false;
-//    }
-//
-//    else if(y>= m_iceman -> getY() - 63 && y < m_iceman -> getY() - 4 && x < m_iceman -> getX() + 4 && x > m_iceman -> getX() - 4 && !NearIceman(x, y, 4))
-//    {
-//        rv = true;
-//        dir = GraphObject::up;
-//        for(int i = y; i != m_iceman -> getY(); i++)
-//            if(!noIcenoBoulder(x, i, GraphObject::up))
-//                rv = false;
-//    }
-//
-//    else if(y<= m_iceman -> getY() + 63 &&  y > m_iceman -> getY() + 4 && x < m_iceman -> getX() + 4 && x > m_iceman -> getX() - 4 && !NearIceman(x, y, 4))
-//    {
-//        rv = true;
-//        dir = GraphObject::down;
-//        for(int i = y; i != m_iceman -> getY(); i--)
-//            if(!noIcenoBoulder(x, i, GraphObject::down))
-//                rv = false;
-//    }
-//
-//    return rv;
-//}
-
 bool StudentWorld::canAddProtester()
 {
-    if (ticksSinceLastProtester >= ticksToWaitToAddProtester && nProtesters < min<unsigned int>(15, 2 + getLevel() * 1.5))
+    int ticksToWait = StressConfig::getInstance().getTicksBetweenProtesters(ticksToWaitToAddProtester);
+
+    if (ticksSinceLastProtester >= ticksToWait && nProtesters < getProtesterCap())
     {
         ticksSinceLastProtester = 0;
-        nProtesters++;
         return true;
     }
 
@@ -288,42 +346,99 @@ bool StudentWorld::canAddProtester()
     return false;
 }
 
-bool StudentWorld::canAddWater(int x, int y)
+void StudentWorld::addProtester()
 {
-    for (int i = 0; i != nIce; i++)
-        if (IcePointers[i] != nullptr)
+    int x = 60;
+    int y = 60;
+
+    if (StressConfig::getInstance().spawnAnywhere())
+        placeProtester(x, y);
+
+    int probabilityOfHardcore = levelRuleOr(m_levelData.hardcoreChance, min<unsigned int>(90, getLevel() * 10 + 30));
+
+    Protester* p;
+
+    if (m_rng.nextInt(100) < probabilityOfHardcore)
+        p = new HardcoreProtester(x, y);
+    else
+        p = new RegularProtester(x, y);
+
+    Actors.push_back(p);
+    m_protesters.push_back(p);
+    nProtesters++;
+    m_protesterGeneration++;
+}
+
+// Stress mode only: scatter protesters over already-open parts of the field
+// instead of queueing them all at the exit. Leaves (x, y) untouched if no
+// open spot turns up.
+void StudentWorld::placeProtester(int& x, int& y)
+{
+    for (int tries = 0; tries != MAX_SPAWN_TRIES; tries++)
+    {
+        int px = m_rng.nextInt(61);
+        int py = m_rng.nextInt(61);
+
+        if (!m_occupancy.anyInBox(OCC_BOULDER, px, py) && canAddWater(px, py))
         {
-            if (IcePointers[i]->getX() >= x && IcePointers[i]->getX() <= x + 3 && IcePointers[i]->getY() >= y && IcePointers[i]->getY() <= y + 3)
-                return false;
+            x = px;
+            y = py;
+            return;
         }
-    return true;
+    }
+}
+
+bool StudentWorld::canAddWater(int x, int y)
+{
+    if (x < 0 || x > 60 || y < 0 || y > 60)
+        return false;
+
+    return m_iceManager.countIce(x, y, 4, 4) == 0;
 }
 
 
-Actor* StudentWorld::findProtester(int x, int y)
+Protester* StudentWorld::findProtester(int x, int y)
 {
-    std::vector<Actor*>::iterator it;
-    for (it = Actors.begin(); it != Actors.end(); it++)
+    std::vector<Protester*>::iterator it;
+    for (it = m_protesters.begin(); it != m_protesters.end(); it++)
     {
         if ((*it)->getX() >= x - 3 && (*it)->getX() <= x + 3 && (*it)->getY() >= y - 3 && (*it)->getY() <= y + 3)
-            if ((*it)->isProtester())
-                return (*it);
+            return (*it);
     }
 
     return nullptr;
 }
 
+void StudentWorld::findProtesters(int x1, int y1, int x2, int y2, std::vector<Protester*>& out)
+{
+    std::vector<Protester*>::iterator it;
+    for (it = m_protesters.begin(); it != m_protesters.end(); it++)
+    {
+        if ((*it)->getX() >= x1 && (*it)->getX() <= x2 && (*it)->getY() >= y1 && (*it)->getY() <= y2)
+            out.push_back(*it);
+    }
+}
+
 
 void StudentWorld::removeDeadGameObjects()
 {
+    std::vector<Protester*>::iterator p;
+
+    for (p = m_protesters.begin(); p != m_protesters.end();)
+        if (!(*p)->isAlive())
+        {
+            nProtesters--;
+            m_protesterGeneration++;
+            p = m_protesters.erase(p);
+        }
+        else
+            p++;
+
     std::vector<Actor*>::iterator it;
 
     for (it = Actors.begin(); it != Actors.end();)
         if (!(*it)->isAlive())
         {
-            setPositions((*it)->getX(), (*it)->getY(), 0);
-            if ((*it)->isProtester())
-                nProtesters--;
             delete (*it);
             it = Actors.erase(it);
 
@@ -336,11 +451,11 @@ void StudentWorld::updateDisplayText()
 {
     int level = getLevel();
     int lives = getLives();
-    int health = m_iceman->gethitPoints() * 10;
-    int squirts = m_iceman->getSquirts();
-    int gold = m_iceman->getGold();
+    int health = m_iceman->getHealth() * 10;
+    int squirts = m_iceman->getNumSquirts();
+    int gold = m_iceman->getNumGoldNuggets();
     int barrelsLeft = nBarrels - pickedBarrels;
-    int sonar = m_iceman->getSonar();
+    int sonar = m_iceman->getNumSonarKits();
     int score = getScore();
     ostringstream oss;
     oss.setf(ios::fixed);
@@ -348,67 +463,142 @@ void StudentWorld::updateDisplayText()
     oss << "Lvl: " << setw(2) << level << "  Lives: " << lives << "  Hlth: " << setw(3) << health << "%" << "  Wtr: " << setw(2) << squirts << "  Gld: " << setw(2) << gold << "  Oil Left: " << setw(2) << barrelsLeft << "  Sonar: " << setw(2) << sonar << "  Scr: ";
     oss.fill('0');
     oss << setw(6) << score;
+    oss.fill(' ');
+    oss << "  Dug: " << setw(3) << m_iceManager.getPercentDug() << "%";
     string text = oss.str();
     setGameStatText(text);
+    m_spectator.setText(text);
 }
 
-//bool StudentWorld::noOverlap(int x, int y)
-//{
-//    std::vector<Actor*>::iterator it;
-//
-//    for (it = Actors.begin(); it != Actors.end(); it++)
-//    {
-//        int square = pow((*it) -> getX() - x, 2) + pow((*it) -> getY() - y, 2);
-//        if(sqrt(square) <= 6)
-//            return false;
-//    }
-//
-//    if (getPositions(x, y) != 0 || getPositions(x+3, y) != 0 || getPositions(x, y+3) != 0 ||getPositions(x+3, y+3) != 0)
-//        return false;
-//
-//    return true;
-//}
+int StudentWorld::move()
+{
+    ActiveWorld active(this);
 
+    // a replay shown in the GUI plays at its own pace: several ticks a frame,
+    // or one every few frames
+    if (!m_replay.isOpen() || GraphObject::isHeadless())
+        return step();
 
-int StudentWorld::move()
+    int status = GWSTATUS_CONTINUE_GAME;
+
+    m_tickCredit += GameOptions::getInstance().getReplaySpeed();
+    while (m_tickCredit >= 1 && status == GWSTATUS_CONTINUE_GAME)
+    {
+        m_tickCredit--;
+        status = step();
+    }
+
+    return status;
+}
+
+// One tick, timed for the stress report.
+int StudentWorld::step()
+{
+    m_tick++;
+
+    int status;
+
+    // clones are look-ahead, not play, so they stay out of the report
+    if (!StressConfig::getInstance().isEnabled() || m_isClone)
+        status = doMove();
+    else
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        status = doMove();
+
+        chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+        m_tickProfiler.record(Actors.size(), elapsed.count());
+    }
+
+    // in practice a death winds the game back instead of costing a life
+    if (status == GWSTATUS_PLAYER_DIED && GameOptions::getInstance().isPracticeMode() && rewind(REWIND_TICKS))
+        status = GWSTATUS_CONTINUE_GAME;
+
+    if (m_spectator.isOpen())
+        broadcastTick();
+
+    return status;
+}
+
+// Sends the world as it stands at the end of a tick to the spectator stream.
+void StudentWorld::broadcastTick()
+{
+    m_spectator.beginTick(m_tick, getLevel(), getLives(), getScore());
+    m_spectator.setIce(m_iceManager);
+
+    if (m_iceman != nullptr)
+        m_spectator.addObject(m_iceman);
+
+    for (size_t i = 0; i != Actors.size(); i++)
+        m_spectator.addObject(Actors[i]);
+
+    m_spectator.endTick();
+}
+
+// Winds the world back ticks ticks, or as far as the rewind buffer goes.
+bool StudentWorld::rewind(unsigned int ticks)
+{
+    if (!m_rewind.rewind(m_tick > ticks ? m_tick - ticks : 0))
+        return false;
+
+    const vector<unsigned char>& image = m_rewind.getImage();
+    if (!restoreSnapshot(&image[0], image.size()))
+        return false;
+
+    m_tick = m_rewind.getTick();
+    return true;
+}
+
+int StudentWorld::doMove()
 {
     updateDisplayText(); //update line to display
 
+    if (canAddProtester())
+        for (int i = 0; i != StressConfig::getInstance().getProtestersPerSpawn() && nProtesters < getProtesterCap(); i++)
+            addProtester();
 
-    int G = getLevel() * 25 + 300;
+    int G = StressConfig::getInstance().getGoodieChance(levelRuleOr(m_levelData.goodieChance, getLevel() * 25 + 300));
 
     //add ps
-    int n = rand() % G + 1;
+    int n = m_rng.nextInt(G) + 1;
 
     if (n <= 1)
     {
-        int prob = rand() % 5 + 1;
+        int prob = m_rng.nextInt(5) + 1;
         if (prob <= 1)
-            Actors.push_back(new Sonar(this));
+            Actors.push_back(new SonarKit());
         else if (prob > 1)
         {
-            int x = rand() % 61;
-            int y = rand() % 61;
-            while (!canAddWater(x, y))
+            int nClear = m_iceManager.getClearAnchorCount();
+
+            if (nClear > 0)
             {
-                x = rand() % 61;
-                y = rand() % 61;
+                int x, y;
+                m_iceManager.getClearAnchor(m_rng.nextInt(nClear), x, y);
+                Actors.push_back(new WaterPool(x, y));
             }
-
-            Actors.push_back(new Water(x, y, this));
         }
     }
 
+    // exit routes asked for on earlier ticks
+    m_pathRequests.update();
+
+    // and items placed since the player last moved
+    m_triggers.update();
+
     //let actor do something and check if player died or ended up level
     if (m_iceman->isAlive())
-        m_iceman->doSomething();
+        m_iceman->move();
+
+    updatePlayerDistances();
 
     std::vector<Actor*>::iterator it;
 
     for (it = Actors.begin(); it != Actors.end(); it++)
     {
         if ((*it)->isAlive())
-            (*it)->doSomething();
+            (*it)->move();
         if (playerDied())
             return GWSTATUS_PLAYER_DIED;
         if (finishedLevel())
@@ -419,20 +609,59 @@ int StudentWorld::move()
     if (playerDied())
         return GWSTATUS_PLAYER_DIED;
 
+    // taken between ticks so a restore picks up exactly here
+    if (m_checkpointRequested)
+    {
+        m_checkpointRequested = false;
+        writeSnapshot(CHECKPOINT_PATH);
+    }
+
+    // and so are a recording's keyframes
+    if (m_recorder.wantsKeyframe(m_tick))
+    {
+        saveSnapshot(m_image);
+        m_recorder.addKeyframe(m_tick, m_image);
+    }
+
+    // and so is the rewind history
+    if (m_rewind.isEnabled())
+    {
+        saveSnapshot(m_image);
+        m_rewind.push(m_tick, m_image);
+    }
+
+    if (m_rewindRequested)
+    {
+        m_rewindRequested = false;
+        rewind(REWIND_TICKS);
+    }
+
+    return GWSTATUS_CONTINUE_GAME;
 }
 
 void StudentWorld::cleanUp()
 {
-    for (int i = 0; i < nIce; i++)
-    {
-        if (IcePointers[i] != nullptr)
-        {
-            delete IcePointers[i];
-            IcePointers[i] = nullptr;
-        }
+    clearWorld();
 
-    }
+    if (StressConfig::getInstance().isEnabled() && !m_isClone)
+        m_tickProfiler.writeReport(StressConfig::getInstance().getReportPath());
+
+    // rewritten at every death and level end, so a crash loses a life's
+    // keys at most
+    if (m_recorder.isRecording() && !m_recorder.write(m_recordPath, m_tick))
+        cout << "Can't write replay " << m_recordPath << endl;
+}
+
+void StudentWorld::clearWorld()
+{
+    ActiveWorld active(this);
+
+    m_iceManager.clear();
     delete m_iceman;
+    m_iceman = nullptr;
+    m_triggers.clear();
+    m_pathRequests.clear();
+    m_protesters.clear();
     std::vector<Actor*>::iterator it;
 
     for (it = Actors.begin(); it != Actors.end();)
@@ -441,7 +670,719 @@ void StudentWorld::cleanUp()
         it = Actors.erase(it);
     }
 
-    for (int x = 0; x != 64; x++)
-        for (int y = 0; y != 64; y++)
-            ActorPositions[x][y] = 0;
-}
\ No newline at end of file
+    m_occupancy.clear();
+    m_snapshotSlots = 0;
+}
+
+void StudentWorld::saveSnapshot(vector<unsigned char>& out)
+{
+    int nLive = 0;
+    int nKeepingSlot = 0;
+    size_t nPathWords = 0;
+
+    for (size_t i = 0; i != Actors.size(); i++)
+    {
+        if (!Actors[i]->isAlive())
+            continue;
+
+        nLive++;
+        if (Actors[i]->getSnapshotSlot() >= 0)
+            nKeepingSlot++;
+    }
+
+    // an actor keeps its record from one image to the next, so a removal
+    // leaves a gap rather than moving every record after it; once the gaps
+    // outnumber the actors the slots are handed out again from the start
+    if (m_snapshotSlots - nKeepingSlot > nLive)
+    {
+        m_snapshotSlots = 0;
+
+        for (size_t i = 0; i != Actors.size(); i++)
+            Actors[i]->setSnapshotSlot(-1);
+    }
+
+    // actors made since the last image act after the rest, so the slots
+    // stay in the order the actors act
+    for (size_t i = 0; i != Actors.size(); i++)
+        if (Actors[i]->isAlive() && Actors[i]->getSnapshotSlot() < 0)
+            Actors[i]->setSnapshotSlot(m_snapshotSlots++);
+
+    for (size_t i = 0; i != m_protesters.size(); i++)
+        if (m_protesters[i]->isAlive())
+            nPathWords += ((size_t)m_protesters[i]->getPathLength() + 31) / 32;
+
+    int nRecords = 1 + m_snapshotSlots;
+
+    // zeroed, so gaps, unused fields and padding always compare equal
+    out.assign(sizeof(SnapshotHeader) + nRecords * sizeof(ActorRecord) + nPathWords * sizeof(uint64_t), 0);
+
+    SnapshotHeader& h = *reinterpret_cast<SnapshotHeader*>(&out[0]);
+    initSnapshotHeader(h, nRecords, nPathWords);
+
+    h.level = getLevel();
+    h.lives = getLives();
+    h.score = getScore();
+    h.protesterGeneration = m_protesterGeneration;
+    h.gridVersion = m_pathFinder.getGridVersion();
+    h.rngState = m_rng.getState();
+    h.nextSeed = m_nextSeed;
+
+    h.ticksSinceLastProtester = ticksSinceLastProtester;
+    h.ticksToWaitToAddProtester = ticksToWaitToAddProtester;
+    h.pickedBarrels = pickedBarrels;
+    h.nBarrels = nBarrels;
+    h.nProtesters = nProtesters;
+    h.nBoulders = nBoulders;
+    h.nGold = nGold;
+    h.initialIceCount = m_iceManager.getInitialIceCount();
+
+    h.maxProtesters = m_levelData.maxProtesters;
+    h.ticksBetweenProtesters = m_levelData.ticksBetweenProtesters;
+    h.goodieChance = m_levelData.goodieChance;
+    h.hardcoreChance = m_levelData.hardcoreChance;
+
+    for (int y = 0; y != 64; y++)
+        h.iceRows[y] = m_iceManager.getRow(y);
+
+    ActorRecord* records = reinterpret_cast<ActorRecord*>(&out[sizeof(SnapshotHeader)]);
+    unsigned long long* pathWords = reinterpret_cast<unsigned long long*>(records + nRecords);
+    m_iceman->saveState(records[0]);
+
+    for (size_t i = 0; i != Actors.size(); i++)
+    {
+        if (!Actors[i]->isAlive())
+            continue;
+
+        ActorRecord& r = records[1 + Actors[i]->getSnapshotSlot()];
+        Actors[i]->saveState(r);
+
+        // a protester's place in the queue, and its route after the records
+        if (isProtesterRecord(r))
+        {
+            Protester* p = static_cast<Protester*>(Actors[i]);
+            r.requestOrder = m_pathRequests.position(p);
+            p->savePath(pathWords);
+            pathWords += getPathWords(r);
+        }
+    }
+}
+
+Actor* StudentWorld::createActor(const ActorRecord& r)
+{
+    Protester* p;
+
+    switch (r.kind)
+    {
+    case SNAP_REGULAR_PROTESTER:
+        p = new RegularProtester(r.x, r.y);
+        m_protesters.push_back(p);
+        return p;
+    case SNAP_HARDCORE_PROTESTER:
+        p = new HardcoreProtester(r.x, r.y);
+        m_protesters.push_back(p);
+        return p;
+    case SNAP_BOULDER:
+        return new Boulder(r.x, r.y);
+    case SNAP_SQUIRT:
+        return new Squirt(r.x, r.y, (GraphObject::Direction)r.direction);
+    case SNAP_BARREL:
+        return new OilBarrel(r.x, r.y);
+    case SNAP_GOLD:
+        return new GoldNugget(r.x, r.y, (Item::States)r.fields[1]);
+    case SNAP_SONAR:
+        return new SonarKit();
+    default:
+        return new WaterPool(r.x, r.y);
+    }
+}
+
+bool StudentWorld::restoreSnapshot(const unsigned char* data, size_t size)
+{
+    if (!validateSnapshot(data, size))
+        return false;
+
+    const SnapshotHeader& h = *reinterpret_cast<const SnapshotHeader*>(data);
+    const ActorRecord* records = reinterpret_cast<const ActorRecord*>(data + sizeof(SnapshotHeader));
+    const unsigned long long* pathWords = reinterpret_cast<const unsigned long long*>(records + h.nRecords);
+
+    ActiveWorld active(this);
+    clearWorld();
+
+    // level first, since constructors read it
+    restoreStats(h.level, h.lives, h.score);
+
+    m_levelData.level = h.level;
+    m_levelData.maxProtesters = h.maxProtesters;
+    m_levelData.ticksBetweenProtesters = h.ticksBetweenProtesters;
+    m_levelData.goodieChance = h.goodieChance;
+    m_levelData.hardcoreChance = h.hardcoreChance;
+    memcpy(m_levelData.iceRows, h.iceRows, sizeof(m_levelData.iceRows));
+
+    m_iceManager.fill(m_levelData.iceRows);
+    m_iceManager.setInitialIceCount(h.initialIceCount);
+
+    // before the actors, since hardcore protesters register the player
+    // field depth they need as they are made
+    m_pathFinder.init(this, &m_iceManager);
+    m_pathRequests.init(&m_pathFinder, StressConfig::getInstance().getPathBudget(),
+        StressConfig::getInstance().usePathThread());
+
+    m_iceman = new Iceman();
+    m_iceman->restoreState(records[0]);
+    m_triggers.playerMovedTo(m_iceman->getX(), m_iceman->getY());
+
+    // protesters waiting for a route, by their place in the queue
+    vector<Protester*> pending(h.nRecords, nullptr);
+
+    for (uint32_t i = 1; i != h.nRecords; i++)
+    {
+        const ActorRecord& r = records[i];
+
+        if (r.kind == SNAP_EMPTY)
+            continue;
+
+        Actor* a = createActor(r);
+        a->restoreState(r);
+        a->setSnapshotSlot(i - 1);
+        Actors.push_back(a);
+
+        if (isProtesterRecord(r))
+        {
+            Protester* p = static_cast<Protester*>(a);
+            p->loadPath(pathWords, r.pathLength);
+            pathWords += getPathWords(r);
+
+            if (r.requestOrder >= 0)
+                pending[r.requestOrder] = p;
+        }
+    }
+
+    for (size_t i = 0; i != pending.size(); i++)
+        if (pending[i] != nullptr)
+            m_pathRequests.submit(pending[i]);
+
+    m_snapshotSlots = h.nRecords - 1;
+    ticksSinceLastProtester = h.ticksSinceLastProtester;
+    ticksToWaitToAddProtester = h.ticksToWaitToAddProtester;
+    pickedBarrels = h.pickedBarrels;
+    nBarrels = h.nBarrels;
+    nProtesters = h.nProtesters;
+    nBoulders = h.nBoulders;
+    nGold = h.nGold;
+    m_protesterGeneration = h.protesterGeneration;
+
+    // and again once the boulders are in place, counting on from the
+    // saved world so the routes' versions still compare
+    m_pathFinder.updateGrid();
+    m_pathFinder.restoreGridVersion(h.gridVersion);
+
+    // constructors above drew from the generator, so this comes last
+    m_rng.setState(h.rngState);
+    m_nextSeed = h.nextSeed;
+
+    return true;
+}
+
+bool StudentWorld::writeSnapshot(const string& path)
+{
+    vector<unsigned char> image;
+    saveSnapshot(image);
+
+    ofstream out(path.c_str(), ios::binary);
+    out.write(reinterpret_cast<const char*>(&image[0]), image.size());
+    return !out.fail();
+}
+
+bool StudentWorld::readSnapshot(const string& path)
+{
+    MappedFile file;
+    return file.open(path) && restoreSnapshot(file.getData(), file.getSize());
+}
+
+bool StudentWorld::getKey(int& value)
+{
+    bool gotKey;
+
+    if (m_hasNextKey)
+    {
+        m_hasNextKey = false;
+        value = m_nextKey;
+        gotKey = true;
+    }
+    // a replay drives the player until its keys run out, then the keyboard
+    // takes over
+    else if (m_replay.isOpen() && !m_replay.isFinished())
+        gotKey = m_replay.getKey(m_tick, value);
+    else
+        gotKey = GameWorld::getKey(value);
+
+    if (gotKey)
+        m_recorder.record(m_tick, value);
+
+    return gotKey;
+}
+
+StudentWorld* StudentWorld::clone()
+{
+    // nothing made for the clone may reach the display lists, and every
+    // actor made here must see the clone as its world
+    bool wasHeadless = GraphObject::isHeadless();
+    GraphObject::setHeadless(true);
+
+    StudentWorld* world = new StudentWorld(assetDirectory());
+    world->m_isClone = true;
+
+    ActiveWorld active(world);
+
+    world->restoreStats(getLevel(), getLives(), getScore());
+    world->m_levelData.level = m_levelData.level;
+    world->m_levelData.maxProtesters = m_levelData.maxProtesters;
+    world->m_levelData.ticksBetweenProtesters = m_levelData.ticksBetweenProtesters;
+    world->m_levelData.goodieChance = m_levelData.goodieChance;
+    world->m_levelData.hardcoreChance = m_levelData.hardcoreChance;
+    world->m_iceManager.share(m_iceManager);
+
+    // the navigation tables too, before any actor asks them for anything
+    world->m_pathFinder.share(m_pathFinder, world, &world->m_iceManager);
+    world->m_pathRequests.init(&world->m_pathFinder, StressConfig::getInstance().getPathBudget(), false);
+
+    // the same per-actor records a snapshot uses, without the image
+    ActorRecord r;
+
+    memset(&r, 0, sizeof(r));
+    m_iceman->saveState(r);
+    world->m_iceman = new Iceman();
+    world->m_iceman->restoreState(r);
+    world->m_triggers.playerMovedTo(r.x, r.y);
+
+    vector<unsigned long long> pathWords;
+    vector<Protester*> pending(Actors.size(), nullptr);
+
+    for (size_t i = 0; i != Actors.size(); i++)
+    {
+        if (!Actors[i]->isAlive())
+            continue;
+
+        memset(&r, 0, sizeof(r));
+        Actors[i]->saveState(r);
+
+        if (isProtesterRecord(r))
+            r.requestOrder = m_pathRequests.position(static_cast<Protester*>(Actors[i]));
+
+        Actor* a = world->createActor(r);
+        a->restoreState(r);
+        world->Actors.push_back(a);
+
+        if (isProtesterRecord(r))
+        {
+            Protester* p = static_cast<Protester*>(a);
+
+            pathWords.resize(getPathWords(r) + 1);
+            static_cast<Protester*>(Actors[i])->savePath(&pathWords[0]);
+            p->loadPath(&pathWords[0], r.pathLength);
+
+            if (r.requestOrder >= 0)
+                pending[r.requestOrder] = p;
+        }
+    }
+
+    for (size_t i = 0; i != pending.size(); i++)
+        if (pending[i] != nullptr)
+            world->m_pathRequests.submit(pending[i]);
+
+    world->ticksSinceLastProtester = ticksSinceLastProtester;
+    world->ticksToWaitToAddProtester = ticksToWaitToAddProtester;
+    world->pickedBarrels = pickedBarrels;
+    world->nBarrels = nBarrels;
+    world->nProtesters = nProtesters;
+    world->nBoulders = nBoulders;
+    world->nGold = nGold;
+    world->m_protesterGeneration = m_protesterGeneration;
+
+    // constructors above drew from the clone's generator
+    world->m_rng = m_rng;
+    world->m_nextSeed = m_nextSeed;
+    world->m_tick = m_tick;
+
+    GraphObject::setHeadless(wasHeadless);
+    return world;
+}
+
+void StudentWorld::benchmarkClones(ostream& out, int clones)
+{
+    typedef chrono::steady_clock Clock;
+    const int keys[5] = { KEY_PRESS_LEFT, KEY_PRESS_RIGHT, KEY_PRESS_UP, KEY_PRESS_DOWN, KEY_PRESS_SPACE };
+
+    GraphObject::setHeadless(true);
+
+    StudentWorld world("");
+    world.init();
+
+    // wander and squirt for a while so there is dug ice and a crowd to copy
+    Random rng(12345);
+    for (int t = 0; t != 1000; t++)
+    {
+        world.setNextKey(keys[rng.nextInt(5)]);
+        if (world.move() != GWSTATUS_CONTINUE_GAME)
+            break;
+    }
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i != clones; i++)
+        delete world.clone();
+    chrono::duration<double, micro> cloneTime = Clock::now() - start;
+
+    // the same state through a snapshot image, for comparison
+    vector<unsigned char> image;
+    StudentWorld copy("");
+    copy.m_isClone = true;
+
+    start = Clock::now();
+    for (int i = 0; i != clones; i++)
+    {
+        world.saveSnapshot(image);
+        copy.restoreSnapshot(&image[0], image.size());
+    }
+    chrono::duration<double, micro> snapshotTime = Clock::now() - start;
+
+    out << "actors,clone_us,clones_per_sec,snapshot_restore_us" << endl;
+    out.setf(ios::fixed);
+    out.precision(2);
+    out << world.Actors.size() + 1 << "," << cloneTime.count() / clones << ","
+        << clones / (cloneTime.count() / 1e6) << "," << snapshotTime.count() / clones << endl;
+
+    GraphObject::setHeadless(false);
+}
+
+// One tick of a replay played without GameController, moving on past
+// deaths and level ends as it would, less the prompts.
+int StudentWorld::replayStep()
+{
+    ActiveWorld active(this);
+
+    int status = step();
+
+    if (status == GWSTATUS_PLAYER_DIED && !isGameOver())
+    {
+        cleanUp();
+        status = init();
+    }
+    else if (status == GWSTATUS_FINISHED_LEVEL)
+    {
+        advanceToNextLevel();
+        cleanUp();
+        status = init();
+    }
+
+    return status;
+}
+
+// Takes a freshly started replay to the end of tick: restores the last
+// keyframe at or before it, then plays the few ticks after.
+bool StudentWorld::seekReplay(unsigned int tick)
+{
+    const unsigned char* image;
+    size_t size;
+    unsigned int keyframeTick;
+
+    // with no keyframe that early, play on from the start
+    if (m_replay.seek(tick, image, size, keyframeTick))
+    {
+        if (!restoreSnapshot(image, size))
+            return false;
+
+        m_tick = keyframeTick;
+    }
+
+    int status = GWSTATUS_CONTINUE_GAME;
+    while (m_tick < tick && status == GWSTATUS_CONTINUE_GAME)
+        status = replayStep();
+
+    return status == GWSTATUS_CONTINUE_GAME;
+}
+
+void StudentWorld::playReplay(ostream& out)
+{
+    typedef chrono::steady_clock Clock;
+
+    GraphObject::setHeadless(true);
+
+    StudentWorld world("");
+    Clock::time_point start = Clock::now();
+    int status = world.init();
+    chrono::duration<double, milli> seekTime = Clock::now() - start;
+    unsigned int firstTick = world.m_tick;
+
+    // play stops where the recording did
+    start = Clock::now();
+    while (status == GWSTATUS_CONTINUE_GAME && world.m_replay.isOpen() && world.m_tick < world.m_replay.getLastTick())
+        status = world.replayStep();
+    chrono::duration<double, milli> elapsed = Clock::now() - start;
+
+    out << "ticks,level,lives,score,seek_ms,ms,ticks_per_sec" << endl;
+    out.setf(ios::fixed);
+    out.precision(2);
+    out << world.m_tick << "," << world.getLevel() << "," << world.getLives() << "," << world.getScore() << ","
+        << seekTime.count() << "," << elapsed.count() << "," << (world.m_tick - firstTick) / (elapsed.count() / 1e3) << endl;
+
+    GraphObject::setHeadless(false);
+}
+
+// Level images that LevelFile::validate() must turn down, each a good one
+// with one thing broken.
+static bool checkLevelFiles(ostream& out)
+{
+    const int NUM_CASES = 10;
+    const char* const cases[NUM_CASES] = { "too short", "bad magic", "bad version", "torn placement",
+        "count past the end", "bad spawn rule", "no goodies", "no barrels", "ice above the surface",
+        "object outside the field" };
+
+    LevelGenerator generator;
+    LevelData level;
+    generator.buildLevel(5, 777, level);
+
+    vector<unsigned char> good;
+    LevelFile::makeImage(level, good);
+
+    string error;
+    if (!LevelFile::validate(&good[0], good.size(), error))
+    {
+        out << "level files: FAILED, a generated level is turned down: " << error << endl;
+        return false;
+    }
+
+    bool ok = true;
+    size_t nPlacements = level.boulders.size() + level.gold.size() + level.barrels.size();
+
+    // the boulder case needs a boulder, which stress options can take away
+    for (int c = 0; c != NUM_CASES + 1; c++)
+    {
+        vector<unsigned char> bad = good;
+        LevelFileHeader& h = *reinterpret_cast<LevelFileHeader*>(&bad[0]);
+        Placement* p = reinterpret_cast<Placement*>(&bad[0] + sizeof(LevelFileHeader));
+
+        switch (c)
+        {
+        case 0:
+            bad.resize(sizeof(LevelFileHeader) - 1);
+            break;
+        case 1:
+            h.magic[0] ^= 1;
+            break;
+        case 2:
+            h.version = LevelFile::VERSION + 1;
+            break;
+        case 3:
+            bad.pop_back();
+            h.fileSize = (uint32_t)bad.size();
+            break;
+        case 4:
+            h.nGold++;
+            break;
+        case 5:
+            h.hardcoreChance = 101;
+            break;
+        case 6:
+            h.goodieChance = 0;
+            break;
+        case 7:
+            h.nBarrels = 0;
+            bad.resize(bad.size() - level.barrels.size() * sizeof(Placement));
+            h.fileSize = (uint32_t)bad.size();
+            break;
+        case 8:
+            h.iceRows[63] = 1;
+            break;
+        case 9:
+            p[nPlacements - 1].x = 61;
+            break;
+        default:
+            if (level.boulders.empty())
+                continue;
+            for (int y = p[0].y; y != p[0].y + 4; y++)
+                h.iceRows[y] |= 0xFULL << p[0].x;
+            break;
+        }
+
+        if (LevelFile::validate(&bad[0], bad.size(), error))
+        {
+            out << "level files: FAILED, accepted one with " << (c < NUM_CASES ? cases[c] : "a buried boulder") << endl;
+            ok = false;
+        }
+    }
+
+    if (ok)
+        out << "level files: ok" << endl;
+    return ok;
+}
+
+bool StudentWorld::selfTest(ostream& out)
+{
+    const int keys[7] = { KEY_PRESS_LEFT, KEY_PRESS_RIGHT, KEY_PRESS_UP, KEY_PRESS_DOWN, KEY_PRESS_SPACE,
+        KEY_PRESS_TAB, 'z' };
+    const unsigned long long SEED = 20240607;
+    const unsigned int MAX_TICKS = 3000;
+    const int REWIND_FRAMES = 200;
+    const char* const REPLAY_PATH = "selftest.rpl";
+
+    GraphObject::setHeadless(true);
+
+    bool ok;
+
+    // in a block so the recording is written for the last time before it
+    // is removed
+    {
+        // a game recorded as with -record, keyframes and all
+        StudentWorld world("");
+        world.m_nextSeed = SEED;
+        world.m_recordPath = REPLAY_PATH;
+        world.m_recorder.start(SEED, 100);
+
+        StudentWorld copy("");
+        copy.m_isClone = true;
+
+        RewindBuffer rewind;
+        rewind.init(REWIND_FRAMES);
+
+        // every tick's image; ticks are counted from 1, across deaths
+        vector<vector<unsigned char> > frames;
+        vector<unsigned char> image;
+        unsigned char nav[64][64];
+        unsigned char freshNav[64][64];
+        unsigned int snapshotFailure = 0;
+        unsigned int gridFailure = 0;
+
+        Random rng(SEED);
+        int status = world.init();
+        int key = 0;
+        int keyTicks = 0;
+
+        while (status == GWSTATUS_CONTINUE_GAME && world.m_tick < MAX_TICKS)
+        {
+            // each key held for a few ticks, so the player gets about
+            if (keyTicks-- == 0)
+            {
+                key = keys[rng.nextInt(7)];
+                keyTicks = rng.nextInt(16);
+            }
+
+            world.setNextKey(key);
+            status = world.replayStep();
+
+            // save, restore elsewhere and save again: the two images must agree
+            world.saveSnapshot(image);
+            frames.push_back(image);
+            rewind.push(world.m_tick, image);
+
+            if (snapshotFailure == 0)
+            {
+                if (!copy.restoreSnapshot(&frames.back()[0], frames.back().size()))
+                    snapshotFailure = world.m_tick;
+                copy.saveSnapshot(image);
+                if (image != frames.back())
+                    snapshotFailure = world.m_tick;
+            }
+
+            // the navigation the world has kept up dig by dig, against one
+            // built from scratch
+            if (gridFailure == 0)
+            {
+                ActiveWorld active(&world);
+                PathFinder fresh;
+                fresh.init(&world, &world.m_iceManager);
+
+                world.m_pathFinder.copyNavigation(nav);
+                fresh.copyNavigation(freshNav);
+                if (memcmp(nav, freshNav, sizeof(nav)) != 0)
+                    gridFailure = world.m_tick;
+
+                for (int x = 0; x <= 60 && gridFailure == 0; x++)
+                    for (int y = 0; y <= 60 && gridFailure == 0; y++)
+                    {
+                        if (world.m_pathFinder.getExitDistance(x, y) != fresh.getExitDistance(x, y))
+                            gridFailure = world.m_tick;
+
+                        for (int d = GraphObject::up; d <= GraphObject::right; d++)
+                        {
+                            GraphObject::Direction dir = (GraphObject::Direction)d;
+                            if (world.m_pathFinder.getClearRun(x, y, dir, 64) != fresh.getClearRun(x, y, dir, 64))
+                                gridFailure = world.m_tick;
+                        }
+                    }
+            }
+        }
+
+        // game over or not, this writes the recording
+        world.cleanUp();
+
+        ok = snapshotFailure == 0 && gridFailure == 0;
+
+        if (snapshotFailure == 0)
+            out << "snapshot round trip: ok" << endl;
+        else
+            out << "snapshot round trip: FAILED at tick " << snapshotFailure << endl;
+
+        if (gridFailure == 0)
+            out << "incremental map updates: ok" << endl;
+        else
+            out << "incremental map updates: FAILED at tick " << gridFailure << endl;
+
+        // wound back newest first, across and between keyframes
+        const int ages[6] = { 1, 5, 31, 33, 64, 150 };
+        unsigned int rewindFailure = 0;
+
+        for (int i = 0; i != 6 && rewindFailure == 0; i++)
+        {
+            if (ages[i] >= (int)frames.size())
+                break;
+
+            unsigned int tick = (unsigned int)(frames.size() - ages[i]);
+            if (!rewind.rewind(tick) || rewind.getTick() != tick || rewind.getImage() != frames[tick - 1])
+                rewindFailure = tick;
+        }
+
+        if (rewindFailure == 0)
+            out << "rewind: ok" << endl;
+        else
+        {
+            out << "rewind: FAILED at tick " << rewindFailure << endl;
+            ok = false;
+        }
+
+        // the recording played back whole, then from a seek half way in
+        for (int seek = 0; seek != 2; seek++)
+        {
+            StudentWorld replayed("");
+            string error;
+            bool same = replayed.m_replay.open(REPLAY_PATH, error);
+
+            if (same)
+            {
+                replayed.m_nextSeed = replayed.m_replay.getSeed();
+                replayed.m_seekTick = seek ? world.m_tick / 2 : 0;
+
+                status = replayed.init();
+                while (status == GWSTATUS_CONTINUE_GAME && replayed.m_tick < replayed.m_replay.getLastTick())
+                    status = replayed.replayStep();
+
+                same = replayed.m_tick == world.m_tick && replayed.getScore() == world.getScore()
+                    && replayed.getLevel() == world.getLevel() && replayed.getLives() == world.getLives();
+            }
+
+            const char* name = seek ? "replay from a seek" : "replay";
+            if (same)
+                out << name << ": ok" << endl;
+            else
+            {
+                out << name << ": FAILED, ended at tick " << replayed.m_tick << " with " << replayed.getScore()
+                    << " points, not tick " << world.m_tick << " with " << world.getScore() << endl;
+                ok = false;
+            }
+        }
+    }
+
+    remove(REPLAY_PATH);
+    GraphObject::setHeadless(false);
+
+    return checkLevelFiles(out) && ok;
+}
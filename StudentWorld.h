@@ -1,20 +1,94 @@
 #ifndef STUDENTWORLD_H_
 #define STUDENTWORLD_H_
 
+#include "GameWorld.h"
 #include "Actor.h"
+#include "StressConfig.h"
+#include "GameOptions.h"
+#include "TickProfiler.h"
+#include "ProximityTriggers.h"
+#include "IceManager.h"
+#include "PathFinder.h"
+#include "PathRequestQueue.h"
+#include "OccupancyGrid.h"
+#include "LevelGenerator.h"
+#include "LevelPrefetcher.h"
+#include "LevelFile.h"
+#include "LevelPack.h"
+#include "Replay.h"
+#include "RewindBuffer.h"
+#include "SpectatorStream.h"
+#include "Random.h"
 #include <string>
 #include <algorithm>
 #include <vector>
+#include <ostream>
 
-class StudentWorld
+class StudentWorld : public GameWorld
 {
 public:
 
-    ~StudentWorld()
+    StudentWorld(std::string assetDir)
+        : GameWorld(assetDir), m_iceman(nullptr), m_nextSeed(0), m_checkpointRequested(false),
+        m_startFromSnapshot(!GameOptions::getInstance().getRestorePath().empty()),
+        m_isClone(false), m_hasNextKey(false), m_nextKey(0), m_tick(0), m_tickCredit(0), m_seekTick(0), m_rewindRequested(false), m_snapshotSlots(0)
+    {
+        // the first world made on a thread is the one its actors use
+        if (instance() == nullptr)
+            instance() = this;
+    }
+
+    virtual ~StudentWorld()
     {
         cleanUp();
+
+        if (instance() == this)
+            instance() = nullptr;
+    }
+
+    // The world actors act on: the game's own, or a clone while it is being
+    // built or stepped (see ActiveWorld).
+    static StudentWorld* getInstance()
+    {
+        return instance();
+    }
+
+    static void setInstance(StudentWorld* world)
+    {
+        instance() = world;
     }
 
+    // A copy of the world for look-ahead, with no Ice objects, graphics or
+    // sound. The ice and navigation tables are shared with this world until
+    // either side digs. The caller owns the clone and steps it with move().
+    StudentWorld* clone();
+
+    // Times clone() on a world played for a while headless, honouring any
+    // stress overrides.
+    static void benchmarkClones(std::ostream& out, int clones);
+
+    // Plays the -replay game headless as fast as it will go, from -seek if
+    // given, and writes how it ended and how long the seek and the rest of
+    // the game took.
+    static void playReplay(std::ostream& out);
+
+    // Plays a game headless, honouring any stress overrides, and checks that
+    // snapshots restore to the same image, that the incremental map updates
+    // match a full rebuild, that rewound frames match the ones pushed, and
+    // that the recording replays to the same end, whole and from a seek.
+    // Also checks that LevelFile::validate() turns down broken levels.
+    // Writes a line per check; false if any failed.
+    static bool selfTest(std::ostream& out);
+
+    // Feeds the player's next key, for worlds with no controller.
+    void setNextKey(int key)
+    {
+        m_nextKey = key;
+        m_hasNextKey = true;
+    }
+
+    bool getKey(int& value);
+
     virtual int init();
 
     bool removeIce(int x, int y);
@@ -23,46 +97,204 @@ public:
 
     virtual void cleanUp();
 
-    void setPositions(int x, int y, char actortype);
+    // The whole world as a flat image (see WorldSnapshot.h), and back. A
+    // bad image leaves the world as it was.
+    void saveSnapshot(std::vector<unsigned char>& out);
+    bool restoreSnapshot(const unsigned char* data, size_t size);
+    bool writeSnapshot(const std::string& path);
+    bool readSnapshot(const std::string& path);
+
+    // Saves a checkpoint at the end of the current tick.
+    void requestCheckpoint()
+    {
+        m_checkpointRequested = true;
+    }
+
+    // Winds the world back a little at the end of the current tick, if
+    // -rewind is on.
+    void requestRewind()
+    {
+        m_rewindRequested = true;
+    }
+
+    OccupancyGrid* getOccupancy()
+    {
+        return &m_occupancy;
+    }
+
+
+    bool boulderInBox(int x, int y);
+
+    IceManager* getIceManager()
+    {
+        return &m_iceManager;
+    }
+
+    PathFinder* getPathFinder()
+    {
+        return &m_pathFinder;
+    }
+
+    PathRequestQueue* getPathRequests()
+    {
+        return &m_pathRequests;
+    }
 
-    char getPositions(int x, int y)
+    // All game-logic randomness comes from here, seeded from the level data.
+    Random& getRandom()
     {
-        return ActorPositions[x][y];
+        return m_rng;
     }
 
+    Iceman* getPlayer()
+    {
+        return m_iceman;
+    }
 
-    bool canFall(int x, int y);
     bool NearIceman(int x, int y, int amount);
+    void scan(int x, int y);
+
+    // Another actor, or the player, whose 4x4 box overlaps box; one that
+    // blocks movement if there is one.
+    Actor* collisionWith(Actor* a, BoundingBox box);
+
+    // Takes ownership of an actor made during the player's move.
+    void acceptActor(Actor* a);
+
+    // The player gives up the level and loses a life.
+    void hitESC();
+
+    ProximityTriggers* getTriggers()
+    {
+        return &m_triggers;
+    }
+
+    void updatePlayerDistances();
+    int getDistSquaredToPlayer(Actor* a);
 
-    Actor* findProtester(int x, int y);
+    Protester* findProtester(int x, int y);
+
+    // Every protester anchored inside [x1, x2] x [y1, y2].
+    void findProtesters(int x1, int y1, int x2, int y2, std::vector<Protester*>& out);
+
+    // Changes whenever a protester is added or removed.
+    unsigned int getProtesterGeneration() const
+    {
+        return m_protesterGeneration;
+    }
     void boulderAnnoyActors(int x, int y);
-    bool annoyProtester(int x, int y, int amt);
-    int generateNewDir(int x, int y);
+    bool annoyProtester(int x, int y, Actor::DamageSource src);
 
     void pickupBarrel(int x, int y);
     bool playerDied();
 
     bool finishedLevel();
-    bool noOverlap(int x, int y);
     void updateDisplayText();
     void removeDeadGameObjects();
 
+    int getProtesterCap();
     bool canAddProtester();
     bool canAddWater(int x, int y);
+    void addProtester();
+    void placeProtester(int& x, int& y);
 
 
 private:
-    int nIce;
-    Ice* IcePointers[3616];
+    int step();
+    int doMove();
+    int replayStep();
+    bool seekReplay(unsigned int tick);
+    bool rewind(unsigned int ticks);
+    void broadcastTick();
+    int loadLevel(int level);
+    Actor* createActor(const ActorRecord& r);
+
+    // What cleanUp() frees, without its report and replay writes, for
+    // restores that replace the world mid-game.
+    void clearWorld();
+
+    static StudentWorld*& instance()
+    {
+        static thread_local StudentWorld* world = nullptr;
+        return world;
+    }
+
+    Iceman* m_iceman;
+    TickProfiler m_tickProfiler;
+    ProximityTriggers m_triggers;
+    IceManager m_iceManager;
+    PathFinder m_pathFinder;
+    PathRequestQueue m_pathRequests;
     std::vector<Actor*> Actors;
+
+    // the protesters among Actors, in the same order
+    std::vector<Protester*> m_protesters;
+    std::vector<int> m_centreX;
+    std::vector<int> m_centreY;
+    std::vector<int> m_distToPlayer;
     int ticksSinceLastProtester;
     int ticksToWaitToAddProtester;
     int nBoulders;
     int nGold;
     int pickedBarrels;
     int nProtesters;
+    unsigned int m_protesterGeneration;
     int nBarrels;
-    char ActorPositions[64][64];
+    OccupancyGrid m_occupancy;
+    LevelGenerator m_levelGenerator;
+    LevelPrefetcher m_prefetcher;
+    LevelFile m_levelFile;
+    LevelPack m_levelPack;
+    LevelData m_levelData;
+    Random m_rng;
+    unsigned long long m_nextSeed;
+    bool m_checkpointRequested;
+    bool m_startFromSnapshot;
+    bool m_isClone;
+    bool m_hasNextKey;
+    int m_nextKey;
+    ReplayRecorder m_recorder;
+
+    // where m_recorder writes, set when it starts
+    std::string m_recordPath;
+    ReplayPlayer m_replay;
+
+    // ticks played this game, across deaths and levels
+    unsigned int m_tick;
+    double m_tickCredit;
+    unsigned int m_seekTick;
+    RewindBuffer m_rewind;
+    bool m_rewindRequested;
+
+    // scratch for keyframes and rewind frames
+    std::vector<unsigned char> m_image;
+
+    // actor records in the last snapshot, gaps included
+    int m_snapshotSlots;
+
+    SpectatorStream m_spectator;
+};
+
+// Makes a world the one actors act on for as long as this is in scope.
+class ActiveWorld
+{
+public:
+    explicit ActiveWorld(StudentWorld* world)
+        : m_previous(StudentWorld::getInstance())
+    {
+        StudentWorld::setInstance(world);
+    }
+
+    ~ActiveWorld()
+    {
+        StudentWorld::setInstance(m_previous);
+    }
+
+private:
+    StudentWorld* m_previous;
+
+    ActiveWorld(const ActiveWorld&);
+    ActiveWorld& operator=(const ActiveWorld&);
 };
 
 #endif // STUDENTWORLD_H_
\ No newline at end of file
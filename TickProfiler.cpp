@@ -0,0 +1,71 @@
+#include "TickProfiler.h"
+#include <fstream>
+#include <iomanip>
+using namespace std;
+
+// Upper bound (inclusive) of each actor-count bucket; the last one is open.
+static const int BUCKET_LIMITS[] = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000 };
+
+TickProfiler::TickProfiler()
+{
+    reset();
+}
+
+int TickProfiler::bucketFor(int actorCount)
+{
+    int i = 0;
+    while (i < NUM_BUCKETS - 1 && actorCount > BUCKET_LIMITS[i])
+        i++;
+    return i;
+}
+
+void TickProfiler::record(int actorCount, double microseconds)
+{
+    int b = bucketFor(actorCount);
+
+    m_ticks[b]++;
+    m_totalMicros[b] += microseconds;
+
+    if (microseconds > m_maxMicros[b])
+        m_maxMicros[b] = microseconds;
+}
+
+void TickProfiler::reset()
+{
+    for (int i = 0; i < NUM_BUCKETS; i++)
+    {
+        m_ticks[i] = 0;
+        m_totalMicros[i] = 0;
+        m_maxMicros[i] = 0;
+    }
+}
+
+void TickProfiler::writeReport(ostream& out) const
+{
+    out << "actors,ticks,avg_us,max_us" << endl;
+    out.setf(ios::fixed);
+    out.precision(1);
+
+    for (int i = 0; i < NUM_BUCKETS; i++)
+    {
+        if (m_ticks[i] == 0)
+            continue;
+
+        if (i < NUM_BUCKETS - 1)
+            out << "<=" << BUCKET_LIMITS[i];
+        else
+            out << ">" << BUCKET_LIMITS[NUM_BUCKETS - 2];
+
+        out << "," << m_ticks[i] << "," << m_totalMicros[i] / m_ticks[i] << "," << m_maxMicros[i] << endl;
+    }
+}
+
+bool TickProfiler::writeReport(const string& path) const
+{
+    ofstream ofs(path);
+    if (!ofs)
+        return false;
+
+    writeReport(ofs);
+    return true;
+}
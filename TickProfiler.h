@@ -0,0 +1,31 @@
+#ifndef TICKPROFILER_H_
+#define TICKPROFILER_H_
+
+#include <string>
+#include <ostream>
+
+// Collects the wall-clock time of each StudentWorld::move() and buckets it by
+// the number of live actors, so a stress run produces a scaling curve from
+// 10 to 10,000 actors instead of a single average.
+class TickProfiler
+{
+public:
+    TickProfiler();
+
+    void record(int actorCount, double microseconds);
+    void reset();
+
+    void writeReport(std::ostream& out) const;
+    bool writeReport(const std::string& path) const;
+
+private:
+    static const int NUM_BUCKETS = 11;
+
+    static int bucketFor(int actorCount);
+
+    int m_ticks[NUM_BUCKETS];
+    double m_totalMicros[NUM_BUCKETS];
+    double m_maxMicros[NUM_BUCKETS];
+};
+
+#endif // TICKPROFILER_H_
@@ -0,0 +1,89 @@
+#include "WorldSnapshot.h"
+#include "OccupancyGrid.h"
+#include <cstring>
+#include <vector>
+using namespace std;
+
+static_assert(sizeof(SnapshotHeader) == 616, "snapshot header layout changed");
+static_assert(sizeof(ActorRecord) == 72, "actor record layout changed");
+
+const char SNAPSHOT_MAGIC[4] = { 'I', 'C', 'E', 'S' };
+
+void initSnapshotHeader(SnapshotHeader& h, int nRecords, size_t nPathWords)
+{
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    h.version = SNAPSHOT_VERSION;
+    h.nRecords = nRecords;
+    h.nPathWords = (uint32_t)nPathWords;
+    h.size = (uint32_t)(sizeof(SnapshotHeader) + nRecords * sizeof(ActorRecord) + nPathWords * sizeof(uint64_t));
+}
+
+bool validateSnapshot(const unsigned char* data, size_t size)
+{
+    if (size < sizeof(SnapshotHeader) + sizeof(ActorRecord))
+        return false;
+
+    const SnapshotHeader& h = *reinterpret_cast<const SnapshotHeader*>(data);
+
+    if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || h.version != SNAPSHOT_VERSION)
+        return false;
+
+    if (h.size != size || h.nRecords == 0
+        || size != sizeof(SnapshotHeader) + (size_t)h.nRecords * sizeof(ActorRecord) + (size_t)h.nPathWords * sizeof(uint64_t))
+        return false;
+
+    const ActorRecord* records = reinterpret_cast<const ActorRecord*>(data + sizeof(SnapshotHeader));
+    size_t nPathWords = 0;
+    int nRequests = 0;
+
+    for (uint32_t i = 0; i != h.nRecords; i++)
+    {
+        const ActorRecord& r = records[i];
+
+        // exactly one player, and it comes first
+        if ((r.kind == SNAP_ICEMAN) != (i == 0) || r.kind >= NUM_SNAPSHOT_KINDS)
+            return false;
+
+        if (r.kind == SNAP_EMPTY)
+            continue;
+
+        if (r.x < 0 || r.x > 60 || r.y < 0 || r.y > 60 || r.direction > 4)
+            return false;
+
+        if (r.occupant < OCC_NONE || r.occupant >= NUM_OCCUPANTS)
+            return false;
+
+        if (isProtesterRecord(r))
+        {
+            if (r.pathLength < 0 || r.requestOrder < -1 || r.requestOrder >= (int32_t)h.nRecords)
+                return false;
+
+            nPathWords += getPathWords(r);
+
+            if (r.requestOrder >= 0)
+                nRequests++;
+        }
+    }
+
+    if (nPathWords != h.nPathWords)
+        return false;
+
+    // the queue positions are 0 to nRequests - 1, each used once
+    vector<bool> taken(nRequests, false);
+
+    for (uint32_t i = 0; i != h.nRecords; i++)
+    {
+        const ActorRecord& r = records[i];
+
+        if (!isProtesterRecord(r) || r.requestOrder < 0)
+            continue;
+
+        if (r.requestOrder >= nRequests || taken[r.requestOrder])
+            return false;
+
+        taken[r.requestOrder] = true;
+    }
+
+    return true;
+}
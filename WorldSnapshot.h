@@ -0,0 +1,110 @@
+#ifndef WORLDSNAPSHOT_H_
+#define WORLDSNAPSHOT_H_
+
+#include <cstdint>
+#include <cstddef>
+
+// Flat binary image of a whole StudentWorld, little-endian: a
+// SnapshotHeader, then the player's ActorRecord and one fixed-size record per
+// actor slot, then the protesters' routes packed as by PackedPath::save(), in
+// the order of their records. Saving and restoring are a pass over fixed-size
+// records, and the image can be kept in memory or written out as it is.
+//
+// An actor keeps its slot from one image to the next and a removed one
+// leaves an empty record, so the actors after it stay where they were (see
+// StudentWorld::saveSnapshot()). Slots are in the order the actors act.
+enum SnapshotKind
+{
+    SNAP_EMPTY,
+    SNAP_ICEMAN,
+    SNAP_REGULAR_PROTESTER,
+    SNAP_HARDCORE_PROTESTER,
+    SNAP_BOULDER,
+    SNAP_SQUIRT,
+    SNAP_BARREL,
+    SNAP_GOLD,
+    SNAP_WATER,
+    SNAP_SONAR,
+    NUM_SNAPSHOT_KINDS
+};
+
+struct SnapshotHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t size;
+    uint32_t nRecords;
+    uint32_t nPathWords;
+
+    uint32_t level;
+    uint32_t lives;
+    uint32_t score;
+    uint32_t protesterGeneration;
+    uint32_t gridVersion;
+
+    uint64_t rngState;
+    uint64_t nextSeed;
+
+    int32_t ticksSinceLastProtester;
+    int32_t ticksToWaitToAddProtester;
+    int32_t pickedBarrels;
+    int32_t nBarrels;
+    int32_t nProtesters;
+    int32_t nBoulders;
+    int32_t nGold;
+    int32_t initialIceCount;
+
+    // the level's own spawn rules (see LevelData)
+    int32_t maxProtesters;
+    int32_t ticksBetweenProtesters;
+    int32_t goodieChance;
+    int32_t hardcoreChance;
+
+    uint64_t iceRows[64];
+};
+
+struct ActorRecord
+{
+    uint8_t kind;
+    uint8_t direction;
+    uint8_t visible;
+    int8_t occupant;
+    int16_t x;
+    int16_t y;
+    int32_t health;
+    int32_t ticksAlive;
+    int32_t iFrames;
+
+    // each class's own fields, in the order its saveState() writes them
+    int32_t fields[10];
+
+    // a protester's route: steps left, the grid version it was planned
+    // on, and its place in the exit-route queue, or -1 if it is not waiting
+    // for one
+    int32_t pathLength;
+    uint32_t pathVersion;
+    int32_t requestOrder;
+};
+
+const uint32_t SNAPSHOT_VERSION = 3;
+
+inline bool isProtesterRecord(const ActorRecord& r)
+{
+    return r.kind == SNAP_REGULAR_PROTESTER || r.kind == SNAP_HARDCORE_PROTESTER;
+}
+
+// Words of route a record has after the records.
+inline size_t getPathWords(const ActorRecord& r)
+{
+    return isProtesterRecord(r) ? ((size_t)r.pathLength + 31) / 32 : 0;
+}
+
+// Fills in the magic, version and size of an image with nRecords records
+// and nPathWords words of routes.
+void initSnapshotHeader(SnapshotHeader& h, int nRecords, size_t nPathWords);
+
+// Checks that an image is a snapshot this build can restore, without
+// touching the world.
+bool validateSnapshot(const unsigned char* data, size_t size);
+
+#endif // WORLDSNAPSHOT_H_
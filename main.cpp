@@ -1,9 +1,17 @@
 #include "GameController.h"
+#include "StressConfig.h"
+#include "GameOptions.h"
+#include "LevelGenerator.h"
+#include "LevelFile.h"
+#include "LevelPack.h"
+#include "StudentWorld.h"
+#include "SpectatorWorld.h"
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <cstdlib>
 #include <ctime>
+#include <thread>
 using namespace std;
 
   // If your program is having trouble finding the Assets directory,
@@ -18,6 +26,43 @@ GameWorld* createStudentWorld(string assetDir = "");
 
 int main(int argc, char* argv[])
 {
+	// IceMan -benchlevels [lastLevel]: time level layout and exit
+	if (argc > 1 && string(argv[1]) == "-benchlevels")
+	{
+		LevelGenerator::benchmark(cout, argc > 2 ? atoi(argv[2]) : 30, 200);
+		return 0;
+	}
+
+	// IceMan -makelevel map.txt map.lvl: convert a hand-authored level
+	if (argc > 3 && string(argv[1]) == "-makelevel")
+	{
+		ifstream in(argv[2]);
+		ofstream out(argv[3], ios::binary);
+		string error;
+
+		if (!in || !LevelFile::convertText(in, out, error))
+		{
+			cout << argv[2] << ": " << (in ? error : "can't open") << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	// IceMan -makepack levels.lvp firstSeed count [threads]: pre-generate
+	// levels 0 to count - 1
+	if (argc > 4 && string(argv[1]) == "-makepack")
+	{
+		int threads = argc > 5 ? atoi(argv[5]) : (int)thread::hardware_concurrency();
+		string error;
+
+		if (!LevelPack::build(argv[2], strtoull(argv[3], nullptr, 10), atoi(argv[4]), threads, error))
+		{
+			cout << error << endl;
+			return 1;
+		}
+		return 0;
+	}
+
 	{
 		string path = assetDirectory;
 		if (!path.empty())
@@ -33,8 +78,42 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	// stress options first: their list runs to the first argument without an =
+	StressConfig::getInstance().parseArgs(argc, argv);
+	GameOptions::getInstance().parseArgs(argc, argv);
+
+	// IceMan [-stress ...] -benchclones [n]: time look-ahead clones and exit
+	if (argc > 1 && string(argv[1]) == "-benchclones")
+	{
+		StudentWorld::benchmarkClones(cout, argc > 2 ? atoi(argv[2]) : 10000);
+		return 0;
+	}
+
+	// IceMan [-stress ...] -selftest: check snapshots, replays, rewinding,
+	// map updates and level files against each other and exit
+	if (argc > 1 && string(argv[1]) == "-selftest")
+		return StudentWorld::selfTest(cout) ? 0 : 1;
+
+	// IceMan [-level ...] -replay game.rpl [-seek tick] -headless: play a
+	// recorded game back at full speed and exit
+	if (argc > 1 && string(argv[1]) == "-headless")
+	{
+		if (GameOptions::getInstance().getReplayPath().empty())
+		{
+			cout << "-headless needs -replay game.rpl" << endl;
+			return 1;
+		}
+		StudentWorld::playReplay(cout);
+		return 0;
+	}
+
 	srand(static_cast<unsigned int>(time(nullptr)));
 
-	GameWorld* gw = createStudentWorld(assetDirectory);
+	// IceMan -spectate game.spec: watch a game sent with -broadcast
+	GameWorld* gw;
+	if (!GameOptions::getInstance().getSpectatePath().empty())
+		gw = new SpectatorWorld(assetDirectory, GameOptions::getInstance().getSpectatePath());
+	else
+		gw = createStudentWorld(assetDirectory);
 	Game().run(argc, argv, gw, "IceMan");
 }